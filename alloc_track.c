@@ -0,0 +1,161 @@
+#include "alloc_track.h"
+#include "order_book.h"
+#include <pthread.h>
+#include <stdatomic.h>
+
+// Counters for one subsystem on one thread
+typedef struct {
+    atomic_ullong liveBytes;
+    atomic_ullong peakBytes;
+    atomic_ullong allocations;
+    atomic_ullong frees;
+} tagCounters;
+
+// Every subsystem's counters for one thread
+typedef struct {
+    tagCounters tags[AllocTagCount];
+    bool shared;                        // The overflow set several threads write to
+} threadAllocCounters;
+
+// Counters of every thread that has allocated -- kept for the life of the process so they can be summed after threads exit
+static threadAllocCounters *threadSets[ALLOC_MAX_THREADS];
+static atomic_int threadSetCount = 0;
+static pthread_mutex_t threadSetLock = PTHREAD_MUTEX_INITIALIZER;
+static threadAllocCounters overflowSet = {.shared = true};
+
+// This thread's counters
+static SIM_LOCAL threadAllocCounters *threadSet = NULL;
+
+static const char *tagNames[AllocTagCount] = {"book_nodes", "orders", "ingest", "telemetry"};
+
+
+// Give this thread its own counters the first time it allocates -- the shared set once there is no room
+static threadAllocCounters *claim_thread_counters() {
+    pthread_mutex_lock(&threadSetLock);
+    int count = atomic_load(&threadSetCount);
+    threadAllocCounters *set = NULL;
+    if (count < ALLOC_MAX_THREADS) {
+        set = calloc(1, sizeof(threadAllocCounters));
+    }
+    if (set != NULL) {
+        threadSets[count] = set;
+        atomic_store_explicit(&threadSetCount, count + 1, memory_order_release);
+    } else {
+        set = &overflowSet;
+    }
+    pthread_mutex_unlock(&threadSetLock);
+    threadSet = set;
+    return set;
+}
+
+
+// Add to a counter -- a plain load and store when only this thread writes it, a locked add for the shared set
+static unsigned long long counter_add(atomic_ullong *counter, unsigned long long amount, bool shared) {
+    if (shared) {
+        return atomic_fetch_add_explicit(counter, amount, memory_order_relaxed) + amount;
+    }
+    unsigned long long value = atomic_load_explicit(counter, memory_order_relaxed) + amount;
+    atomic_store_explicit(counter, value, memory_order_relaxed);
+    return value;
+}
+
+
+// Count an allocation made outside the tracked_* wrappers (e.g. aligned buffers)
+void alloc_record(allocTag tag, size_t size) {
+    threadAllocCounters *set = (threadSet != NULL) ? threadSet : claim_thread_counters();
+    tagCounters *counters = &set->tags[tag];
+    unsigned long long live = counter_add(&counters->liveBytes, size, set->shared);
+    counter_add(&counters->allocations, 1, set->shared);
+    // Racy on the shared set, so its peak is only approximate
+    if (live > atomic_load_explicit(&counters->peakBytes, memory_order_relaxed)) {
+        atomic_store_explicit(&counters->peakBytes, live, memory_order_relaxed);
+    }
+}
+
+
+// Count a free of something counted by alloc_record -- size must match what was recorded
+void alloc_release(allocTag tag, size_t size) {
+    threadAllocCounters *set = (threadSet != NULL) ? threadSet : claim_thread_counters();
+    tagCounters *counters = &set->tags[tag];
+    // A thread freeing another thread's memory wraps its own live count, but the sum over threads stays right
+    counter_add(&counters->liveBytes, -(unsigned long long) size, set->shared);
+    counter_add(&counters->frees, 1, set->shared);
+}
+
+
+// malloc counted against a subsystem
+void *tracked_malloc(allocTag tag, size_t size) {
+    void *ptr = malloc(size);
+    if (ptr != NULL) {
+        alloc_record(tag, size);
+    }
+    return ptr;
+}
+
+
+// calloc counted against a subsystem
+void *tracked_calloc(allocTag tag, size_t count, size_t size) {
+    void *ptr = calloc(count, size);
+    if (ptr != NULL) {
+        alloc_record(tag, count * size);
+    }
+    return ptr;
+}
+
+
+// realloc counted against a subsystem -- oldSize is what ptr was last allocated with (0 for NULL)
+void *tracked_realloc(allocTag tag, void *ptr, size_t oldSize, size_t newSize) {
+    void *grown = realloc(ptr, newSize);
+    if (grown != NULL) {
+        if (ptr != NULL) {
+            alloc_release(tag, oldSize);
+        }
+        alloc_record(tag, newSize);
+    }
+    return grown;
+}
+
+
+// free counted against a subsystem -- size must match the allocation
+void tracked_free(allocTag tag, void *ptr, size_t size) {
+    if (ptr == NULL) {
+        return;
+    }
+    free(ptr);
+    alloc_release(tag, size);
+}
+
+
+// Sum every thread's counters for each subsystem
+void alloc_stats_read(allocStats stats[AllocTagCount]) {
+    memset(stats, 0, sizeof(allocStats) * AllocTagCount);
+    int count = atomic_load_explicit(&threadSetCount, memory_order_acquire);
+    for (int i = 0; i <= count; i++) {
+        threadAllocCounters *set = (i < count) ? threadSets[i] : &overflowSet;
+        for (int tag = 0; tag < AllocTagCount; tag++) {
+            tagCounters *counters = &set->tags[tag];
+            stats[tag].liveBytes += atomic_load_explicit(&counters->liveBytes, memory_order_relaxed);
+            stats[tag].peakBytes += atomic_load_explicit(&counters->peakBytes, memory_order_relaxed);
+            stats[tag].allocations += atomic_load_explicit(&counters->allocations, memory_order_relaxed);
+            stats[tag].frees += atomic_load_explicit(&counters->frees, memory_order_relaxed);
+        }
+    }
+}
+
+
+// Bytes currently allocated through the tracker across every subsystem and thread
+unsigned long long alloc_live_bytes() {
+    allocStats stats[AllocTagCount];
+    alloc_stats_read(stats);
+    unsigned long long live = 0;
+    for (int tag = 0; tag < AllocTagCount; tag++) {
+        live += stats[tag].liveBytes;
+    }
+    return live;
+}
+
+
+// Name of a subsystem for reports
+const char *alloc_tag_name(allocTag tag) {
+    return (tag >= 0 && tag < AllocTagCount) ? tagNames[tag] : "unknown";
+}
\ No newline at end of file
@@ -0,0 +1,35 @@
+#ifndef ALLOC_TRACK_H
+#define ALLOC_TRACK_H
+
+// Standard includes
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+
+// Define how many threads get their own counters -- later threads share one set
+#define ALLOC_MAX_THREADS 64
+
+// Subsystems that allocations are counted against
+typedef enum {AllocBookNodes, AllocOrders, AllocIngest, AllocTelemetry, AllocTagCount} allocTag;
+
+// Allocation totals for one subsystem
+typedef struct {
+    unsigned long long liveBytes;
+    unsigned long long peakBytes;       // Sum of each thread's peak -- an upper bound when threads peak at different times
+    unsigned long long allocations;
+    unsigned long long frees;
+} allocStats;
+
+// Function declarations
+void alloc_record(allocTag tag, size_t size);
+void alloc_release(allocTag tag, size_t size);
+void *tracked_malloc(allocTag tag, size_t size);
+void *tracked_calloc(allocTag tag, size_t count, size_t size);
+void *tracked_realloc(allocTag tag, void *ptr, size_t oldSize, size_t newSize);
+void tracked_free(allocTag tag, void *ptr, size_t size);
+void alloc_stats_read(allocStats stats[AllocTagCount]);
+unsigned long long alloc_live_bytes();
+const char *alloc_tag_name(allocTag tag);
+
+#endif
\ No newline at end of file
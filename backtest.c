@@ -0,0 +1,320 @@
+#include "backtest.h"
+#include "benchmark.h"
+#include "alloc_track.h"
+#include <pthread.h>
+#include <stdatomic.h>
+
+// Vector comparisons for the block replay trigger scan
+#if defined(__AVX__)
+    #include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+    #include <emmintrin.h>
+#endif
+
+// Queue of sweep points shared between worker threads
+typedef struct {
+    const tickData *ticks;
+    const sweepParams *grid;
+    int count;
+    const sweepConfig *config;
+    sweepResult *results;
+    atomic_int nextJob;
+} sweepJobs;
+
+
+// Insert a tick's bid and ask into the trees
+static void insert_tick_into_book(const orderLine *line) {
+    // Creates node in the bid tree
+    node *bid_node = tracked_malloc(AllocBookNodes, sizeof(node));
+    if (!bid_node) {
+        printf("Error Allocating Memory!\n");
+        exit(-1);
+    }
+    *bid_node = (node){line->bidPrice, line->bidVolume, Red, NULL, NULL, NULL};
+
+    // Creates node in the ask tree
+    node *ask_node = tracked_malloc(AllocBookNodes, sizeof(node));
+    if (!ask_node) {
+        printf("Error Allocating Memory!\n");
+        exit(-1);
+    }
+    *ask_node = (node){line->askPrice, line->askVolume, Red, NULL, NULL, NULL};
+
+    // Inserts these new nodes
+    insert_node(&bidTree, bid_node);
+    insert_node(&askTree, ask_node);
+}
+
+
+// Run one tick through the book, strategies and matching engine
+void process_tick(const orderLine *line, long long timestamp, long long tick, bookView *book) {
+    insert_tick_into_book(line);
+
+    // New orders are risk checked against this tick's time and mid price
+    risk_on_tick(timestamp, line->bidPrice, line->askPrice);
+
+    // Move the order clock to this tick's timestamp
+    advance_order_clock(timestamp, tick);
+
+    // Create new orders based on registered strategies
+    build_book_view(book, line, timestamp, tick);
+    strategies_on_tick(book);
+
+    // Orders which have now reached the book become live
+    release_arrived_orders();
+
+    // Try to complete orders with updated order book
+    match_all_orders();
+}
+
+
+// Put this thread's simulator back to an empty book, order table and account
+void reset_simulation(double startingBalance, latencyModel latency, riskLimits risk) {
+    free_tree(&bidTree);
+    free_tree(&askTree);
+    freeHashTable();
+    free_pending_orders();
+    clear_strategies();
+    countID = 0;
+    user = (userAccount){0, startingBalance};
+    set_latency_model(latency);
+    set_risk_limits(risk);
+    risk_reset();
+}
+
+
+// Reset this thread's simulator and register the support/resistance strategy for one run
+static void begin_instance(supportResistanceState *levels, const sweepConfig *config) {
+    reset_simulation(config->startingBalance, config->latency, config->risk);
+    register_strategy(&supportResistanceStrategy, levels, &user);
+    strategies_init();
+}
+
+
+// Collect a finished run's results and free everything it allocated
+static void finish_instance(const sweepParams *params, const sweepConfig *config, bookView *book, sweepResult *result) {
+    strategies_on_end(book);
+
+    // Value what is left at the final best bid
+    node *best_bid = find_best_node(&bidTree);
+    double mark = (best_bid != NULL) ? best_bid->price : 0.0;
+    result->params = *params;
+    result->baseBalance = user.baseCurrencyBalance;
+    result->quoteBalance = user.quoteCurrencyBalance;
+    result->endValue = user.baseCurrencyBalance * mark + user.quoteCurrencyBalance;
+    result->profitLoss = result->endValue - config->startingBalance;
+    result->ordersPlaced = countID;
+    result->fills = fills_reported();
+    result->riskRejections = 0;
+    for (int i = RiskAccepted + 1; i < RiskReasonCount; i++) {
+        result->riskRejections += risk_rejection_count(i);
+    }
+
+    // Leave nothing allocated between runs
+    freeHashTable();
+    free_pending_orders();
+    free_tree(&bidTree);
+    free_tree(&askTree);
+    clear_strategies();
+}
+
+
+// Replay the whole tick file for one set of parameters on the calling thread
+void run_backtest(const tickData *ticks, const sweepParams *params, const sweepConfig *config, sweepResult *result) {
+    double start = get_time_ms();
+
+    // Each instance trades its own copy of the levels
+    supportResistanceState levels = {params->support, params->resistance};
+    begin_instance(&levels, config);
+
+    bookView book = {0};
+    for (size_t i = 0; i < ticks->count; i++) {
+        process_tick(&ticks->lines[i], ticks->timestamps[i], (long long)i + 1, &book);
+    }
+    finish_instance(params, config, &book, result);
+    result->runTimeMs = get_time_ms() - start;
+}
+
+
+// Mark which of up to 64*4 ticks could trigger the thresholds (ask <= support or bid >= resistance)
+// Returns non-zero if any tick in the block is a candidate
+int find_trigger_candidates(const double *bidPrices, const double *askPrices, int count, double support, double resistance, unsigned long long *mask) {
+    unsigned long long found = 0;
+    int i = 0;
+    memset(mask, 0, sizeof(unsigned long long) * ((count + 63) / 64));
+
+#if defined(__AVX__)
+    // Four ticks per comparison
+    __m256d supportVec = _mm256_set1_pd(support);
+    __m256d resistanceVec = _mm256_set1_pd(resistance);
+    for (; i + 4 <= count; i += 4) {
+        __m256d buy = _mm256_cmp_pd(_mm256_loadu_pd(askPrices + i), supportVec, _CMP_LE_OQ);
+        __m256d sell = _mm256_cmp_pd(_mm256_loadu_pd(bidPrices + i), resistanceVec, _CMP_GE_OQ);
+        unsigned long long bits = (unsigned) _mm256_movemask_pd(_mm256_or_pd(buy, sell));
+        mask[i >> 6] |= bits << (i & 63);
+        found |= bits;
+    }
+#elif defined(__SSE2__) || defined(_M_X64)
+    // Two ticks per comparison
+    __m128d supportVec = _mm_set1_pd(support);
+    __m128d resistanceVec = _mm_set1_pd(resistance);
+    for (; i + 2 <= count; i += 2) {
+        __m128d buy = _mm_cmple_pd(_mm_loadu_pd(askPrices + i), supportVec);
+        __m128d sell = _mm_cmpge_pd(_mm_loadu_pd(bidPrices + i), resistanceVec);
+        unsigned long long bits = (unsigned) _mm_movemask_pd(_mm_or_pd(buy, sell));
+        mask[i >> 6] |= bits << (i & 63);
+        found |= bits;
+    }
+#endif
+    // Whatever is left (or everything, without SIMD)
+    for (; i < count; i++) {
+        unsigned long long bit = (askPrices[i] <= support || bidPrices[i] >= resistance);
+        mask[i >> 6] |= bit << (i & 63);
+        found |= bit;
+    }
+    return found != 0;
+}
+
+
+// Bring the book up to date with ticks [from, to) that were skipped
+static void catch_up_book(const tickData *ticks, size_t from, size_t to) {
+    // Long gaps are rebuilt from only the most recent ticks -- the touch is always exact, deeper levels
+    // can only differ if they were set more than REPLAY_WINDOW ticks ago
+    if (to - from > REPLAY_WINDOW) {
+        free_tree(&bidTree);
+        free_tree(&askTree);
+        from = to - REPLAY_WINDOW;
+    }
+    for (size_t i = from; i < to; i++) {
+        insert_tick_into_book(&ticks->lines[i]);
+    }
+}
+
+
+/* Replay for fixed threshold strategies -- ticks are scanned REPLAY_BLOCK_SIZE at a time with vector compares
+   and only ticks that could trigger support/resistance (or that have our orders resting/travelling against them)
+   get the full book, strategy and matching work. Skipped ticks are folded into the book just before the
+   next tick that needs it, so every decision sees the same top of book as run_backtest
+*/
+void run_backtest_blocked(const tickData *ticks, const sweepParams *params, const sweepConfig *config, sweepResult *result) {
+    double start = get_time_ms();
+
+    supportResistanceState levels = {params->support, params->resistance};
+    begin_instance(&levels, config);
+
+    bookView book = {0};
+    unsigned long long mask[REPLAY_BLOCK_SIZE / 64];
+    size_t synced = 0;  // Ticks before this are already in the book
+
+    for (size_t blockStart = 0; blockStart < ticks->count; blockStart += REPLAY_BLOCK_SIZE) {
+        int blockCount = (ticks->count - blockStart < REPLAY_BLOCK_SIZE) ? (int)(ticks->count - blockStart) : REPLAY_BLOCK_SIZE;
+        int anyCandidates = find_trigger_candidates(ticks->bidPrices + blockStart, ticks->askPrices + blockStart,
+                                                    blockCount, params->support, params->resistance, mask);
+
+        // Nothing in this block can trigger and we have no orders that need matching
+        if (!anyCandidates && open_order_count() == 0 && pending_order_count() == 0) {
+            continue;
+        }
+        for (int j = 0; j < blockCount; j++) {
+            bool candidate = (mask[j >> 6] >> (j & 63)) & 1;
+            if (!candidate && open_order_count() == 0 && pending_order_count() == 0) {
+                continue;
+            }
+            size_t i = blockStart + j;
+            catch_up_book(ticks, synced, i);
+            process_tick(&ticks->lines[i], ticks->timestamps[i], (long long)i + 1, &book);
+            synced = i + 1;
+        }
+    }
+    // Final mark uses the book as of the last tick
+    catch_up_book(ticks, synced, ticks->count);
+    if (ticks->count > 0) {
+        build_book_view(&book, &ticks->lines[ticks->count - 1], ticks->timestamps[ticks->count - 1], (long long)ticks->count);
+    }
+    finish_instance(params, config, &book, result);
+    result->runTimeMs = get_time_ms() - start;
+}
+
+
+// Worker thread -- keeps taking the next sweep point until none are left
+static void *sweep_worker(void *arg) {
+    sweepJobs *jobs = (sweepJobs*) arg;
+    int job;
+    while ((job = atomic_fetch_add(&jobs->nextJob, 1)) < jobs->count) {
+        if (jobs->config->blockReplay) {
+            run_backtest_blocked(jobs->ticks, &jobs->grid[job], jobs->config, &jobs->results[job]);
+        } else {
+            run_backtest(jobs->ticks, &jobs->grid[job], jobs->config, &jobs->results[job]);
+        }
+    }
+    return NULL;
+}
+
+
+// Number of cores available to run workers on
+static int available_cores() {
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return (int) info.dwNumberOfProcessors;
+#else
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    return (cores > 0) ? (int) cores : 1;
+#endif
+}
+
+
+// Run every point in the grid over the same read-only ticks using a pool of threads
+void run_parameter_sweep(const tickData *ticks, const sweepParams *grid, int count, const sweepConfig *config, sweepResult *results) {
+    int threads = (config->threads > 0) ? config->threads : available_cores();
+    if (threads > count) {
+        threads = count;
+    }
+    sweepJobs jobs = {ticks, grid, count, config, results, 0};
+
+    pthread_t *workers = malloc(sizeof(pthread_t) * threads);
+    if (!workers) {
+        printf("Error Allocating Memory!\n");
+        exit(-1);
+    }
+    printf("Running %d parameter sets over %zu ticks on %d threads\n", count, ticks->count, threads);
+    // Only join the workers that actually started -- the rest of the grid is picked up by those that did
+    int started = 0;
+    for (int i = 0; i < threads; i++) {
+        if (pthread_create(&workers[started], NULL, sweep_worker, &jobs) == 0) {
+            started++;
+        }
+    }
+    if (started < threads) {
+        printf("Failed to start %d of %d sweep threads\n", threads - started, threads);
+    }
+    // No workers at all - run the whole grid on this thread
+    if (started == 0) {
+        sweep_worker(&jobs);
+    }
+    for (int i = 0; i < started; i++) {
+        pthread_join(workers[i], NULL);
+    }
+    free(workers);
+}
+
+
+// Display all sweep results in one table, marking the most profitable
+void print_sweep_results(const sweepResult *results, int count, double lotSize) {
+    int best = 0;
+    for (int i = 1; i < count; i++) {
+        if (results[i].profitLoss > results[best].profitLoss) {
+            best = i;
+        }
+    }
+    printf("\n=== PARAMETER SWEEP RESULTS ===\n");
+    printf("%-10s %-10s %14s %14s %10s %10s %10s %10s\n", "Support", "Resistance", "End Value", "P/L", "Orders", "Fills", "Rejected", "Time(ms)");
+    printf("-----------------------------------------------------------------------------------------------------\n");
+    for (int i = 0; i < count; i++) {
+        printf("%-10.5f %-10.5f %14.2f %14.2f %10d %10d %10lld %10.1f%s\n",
+               results[i].params.support, results[i].params.resistance,
+               results[i].endValue * lotSize, results[i].profitLoss * lotSize,
+               results[i].ordersPlaced, results[i].fills, results[i].riskRejections, results[i].runTimeMs,
+               (i == best) ? "  <- best" : "");
+    }
+}
\ No newline at end of file
@@ -0,0 +1,60 @@
+#ifndef BACKTEST_H
+#define BACKTEST_H
+
+// Standard includes
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+
+// Including other project headers
+#include "data_read.h"
+#include "order_book.h"
+#include "matching.h"
+#include "strategy.h"
+#include "latency.h"
+
+// One point in a parameter sweep
+typedef struct {
+    double support;
+    double resistance;
+} sweepParams;
+
+// Settings shared by every simulator instance in a sweep
+typedef struct {
+    double startingBalance;     // Quote currency we begin with
+    latencyModel latency;
+    int threads;                // Worker threads -- 0 uses every core
+    bool blockReplay;           // Skip ticks that can't trigger the thresholds (see run_backtest_blocked)
+    riskLimits risk;
+} sweepConfig;
+
+// Outcome of a single simulator instance
+typedef struct {
+    sweepParams params;
+    double baseBalance;
+    double quoteBalance;
+    double endValue;            // Marked at the final best bid
+    double profitLoss;
+    int ordersPlaced;
+    int fills;
+    long long riskRejections;
+    double runTimeMs;
+} sweepResult;
+
+// Define how many ticks the block replay scans at once
+#define REPLAY_BLOCK_SIZE 256
+
+// Define how many skipped ticks are replayed into the book before a tick that needs full processing
+#define REPLAY_WINDOW 1024
+
+// Function declarations
+void process_tick(const orderLine *line, long long timestamp, long long tick, bookView *book);
+void reset_simulation(double startingBalance, latencyModel latency, riskLimits risk);
+void run_backtest(const tickData *ticks, const sweepParams *params, const sweepConfig *config, sweepResult *result);
+void run_backtest_blocked(const tickData *ticks, const sweepParams *params, const sweepConfig *config, sweepResult *result);
+int find_trigger_candidates(const double *bidPrices, const double *askPrices, int count, double support, double resistance, unsigned long long *mask);
+void run_parameter_sweep(const tickData *ticks, const sweepParams *grid, int count, const sweepConfig *config, sweepResult *results);
+void print_sweep_results(const sweepResult *results, int count, double lotSize);
+
+#endif
\ No newline at end of file
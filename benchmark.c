@@ -1,31 +1,108 @@
 // benchmark.c - Implementation
 #include "benchmark.h"
 #include "order_book.h"
+#include "indicators.h"
+#include "perf_trace.h"
+#include "perf_counters.h"
+#include <pthread.h>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+    #define PERF_HAVE_TSC 1
+    #if defined(_MSC_VER)
+        #include <intrin.h>
+    #else
+        #include <x86intrin.h>
+        #include <cpuid.h>
+    #endif
+#endif
+
+// How long the TSC is measured against the monotonic clock when picking the timing clock
+#define TSC_CALIBRATION_MS 20
 
 PerfMonitor perf_monitor = {0};
-static double current_start_time = 0;
-static char current_metric_name[64] = {0};
 
+// A timing in progress on this thread's timer stack
+typedef struct {
+    int metric;
+    int path;
+    unsigned long long start_ticks;
+    unsigned long long child_ticks;     // Inclusive time of the timings nested inside this one
+    unsigned long long hw_start[HwCounterCount];
+    bool hw_valid;
+} PerfFrame;
+
+// Each thread nests its own timings
+static SIM_LOCAL PerfFrame perf_stack[PERF_MAX_DEPTH];
+static SIM_LOCAL int perf_depth = 0;
+
+// Every thread that has timed something -- kept for the life of the process so they can be summed after threads
+// exit. The lock covers this list and the metric names, never a timing itself
+static PerfThreadTimings *perf_threads[PERF_MAX_THREADS];
+static int perf_thread_count = 0;
+static pthread_mutex_t perf_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// This thread's timings
+static SIM_LOCAL PerfThreadTimings *perf_thread = NULL;
+static SIM_LOCAL bool perf_thread_refused = false;
+
+static inline unsigned long long perf_clock_start();
+
+
+// Zero a table of metrics, keeping any names
+static void reset_metrics(PerfMetric *metrics, int count) {
+    for (int i = 0; i < count; i++) {
+        PerfMetric *m = &metrics[i];
+        m->total_ticks = 0;
+        m->self_ticks = 0;
+        memset(m->hw, 0, sizeof(m->hw));
+        m->hw_calls = 0;
+        m->call_count = 0;
+        m->min_ticks = 0;
+        m->max_ticks = 0;
+        m->memory_used = 0;
+        memset(&m->histogram, 0, sizeof(PerfHistogram));
+    }
+}
 
-// Create log file
+// Create log file -- metric handles stay registered so call sites can keep theirs. Every thread's timings are
+// cleared, so call it while no other thread is timing
 void perf_init(const char* log_filename) {
-    memset(&perf_monitor, 0, sizeof(PerfMonitor));
+    perf_cleanup();
+    perf_clock_init();
+    pthread_mutex_lock(&perf_lock);
+    reset_metrics(perf_monitor.metrics, perf_monitor.metric_count);
+    perf_monitor.paths[0] = (PerfPath){-1, -1, -1, -1, 0};
+    perf_monitor.path_count = 1;
+    for (int i = 0; i < perf_thread_count; i++) {
+        reset_metrics(perf_threads[i]->metrics, PERF_MAX_METRICS);
+        perf_threads[i]->paths[0] = (PerfPath){-1, -1, -1, -1, 0};
+        perf_threads[i]->path_count = 1;
+    }
+    pthread_mutex_unlock(&perf_lock);
+    perf_depth = 0;
     perf_monitor.program_start_time = get_time_ms();
+    perf_monitor.program_start_ticks = perf_clock_start();
     
+    // Timings are traced in binary by a background thread and turned into the CSV log at cleanup
+    perf_monitor.log_filename[0] = '\0';
     if (log_filename) {
-        perf_monitor.log_file = fopen(log_filename, "w");
-        if (perf_monitor.log_file) {
-            fprintf(perf_monitor.log_file, "timestamp,operation,duration_ms,memory_kb\n");
-        }
+        snprintf(perf_monitor.log_filename, sizeof(perf_monitor.log_filename), "%s", log_filename);
+        snprintf(perf_monitor.trace_filename, sizeof(perf_monitor.trace_filename), "%s.trace", log_filename);
+        trace_start(perf_monitor.trace_filename, perf_monitor.ns_per_tick, perf_monitor.program_start_ticks);
     }
     
     printf("Performance monitoring initialized\n");
 }
 
-// Close log file
+// Stop tracing and write the CSV log
 void perf_cleanup() {
-    if (perf_monitor.log_file) {
-        fclose(perf_monitor.log_file);
+    if (trace_active()) {
+        const char *names[PERF_MAX_METRICS];
+        for (int i = 0; i < perf_monitor.metric_count; i++) {
+            names[i] = perf_monitor.metrics[i].name;
+        }
+        trace_stop(names, perf_monitor.metric_count);
+        trace_to_csv(perf_monitor.trace_filename, perf_monitor.log_filename);
     }
 }
 
@@ -96,49 +173,321 @@ size_t get_memory_usage_kb() {
 #endif
 }
 
-// Start timing a block of code logic
-void perf_start_timing(const char* metric_name) {
-    current_start_time = get_time_ms();
-    strncpy(current_metric_name, metric_name, sizeof(current_metric_name) - 1);
-    current_metric_name[sizeof(current_metric_name) - 1] = '\0';
+// Nanoseconds from the monotonic clock -- the fallback timing clock
+static unsigned long long monotonic_ns() {
+#ifdef _WIN32
+    static LARGE_INTEGER frequency = {0};
+    LARGE_INTEGER counter;
+    if (frequency.QuadPart == 0) {
+        QueryPerformanceFrequency(&frequency);
+    }
+    QueryPerformanceCounter(&counter);
+    return (unsigned long long)(counter.QuadPart * (1000000000.0 / frequency.QuadPart));
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+#endif
 }
 
-// Denote end of a block that we have been timing
-void perf_end_timing(const char* metric_name) {
-    double end_time = get_time_ms();
-    double duration = end_time - current_start_time;
-    
-    // Find or create metric
-    PerfMetric *metric = NULL;
-    for (int i = 0; i < perf_monitor.metric_count; i++) {
+// Check the CPU's invariant TSC flag (CPUID 0x80000007, EDX bit 8) -- the TSC then ticks at a constant rate
+static int tsc_is_invariant() {
+#if defined(PERF_HAVE_TSC) && defined(_MSC_VER)
+    int regs[4];
+    __cpuid(regs, 0x80000000);
+    if ((unsigned int)regs[0] < 0x80000007) return 0;
+    __cpuid(regs, 0x80000007);
+    return (regs[3] >> 8) & 1;
+#elif defined(PERF_HAVE_TSC)
+    unsigned int eax, ebx, ecx, edx;
+    if (__get_cpuid_max(0x80000000, NULL) < 0x80000007) return 0;
+    if (!__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx)) return 0;
+    return (edx >> 8) & 1;
+#else
+    return 0;
+#endif
+}
+
+// Read the timing clock at the start of a timing -- rdtsc, fenced so earlier work can't drift into the timing
+static inline unsigned long long perf_clock_start() {
+#ifdef PERF_HAVE_TSC
+    if (perf_monitor.clock_source == PerfClockTsc) {
+        _mm_lfence();
+        return __rdtsc();
+    }
+#endif
+    return monotonic_ns();
+}
+
+// Read the timing clock at the end of a timing -- rdtscp waits for the timed work to finish
+static inline unsigned long long perf_clock_stop() {
+#ifdef PERF_HAVE_TSC
+    if (perf_monitor.clock_source == PerfClockTsc) {
+        unsigned int aux;
+        unsigned long long ticks = __rdtscp(&aux);
+        _mm_lfence();
+        return ticks;
+    }
+#endif
+    return monotonic_ns();
+}
+
+// Choose the timing clock and work out how long a tick is -- only does the work once
+void perf_clock_init() {
+    if (perf_monitor.ns_per_tick > 0) return;
+    perf_monitor.clock_source = PerfClockMonotonic;
+    perf_monitor.ns_per_tick = 1.0;
+
+#ifdef PERF_HAVE_TSC
+    if (tsc_is_invariant()) {
+        // Count TSC ticks over a stretch of monotonic time
+        unsigned long long start_ns = monotonic_ns();
+        unsigned long long start_tsc = __rdtsc();
+        while (monotonic_ns() - start_ns < TSC_CALIBRATION_MS * 1000000ULL);
+        unsigned long long end_tsc = __rdtsc();
+        unsigned long long end_ns = monotonic_ns();
+
+        if (end_tsc > start_tsc) {
+            perf_monitor.clock_source = PerfClockTsc;
+            perf_monitor.ns_per_tick = (double)(end_ns - start_ns) / (end_tsc - start_tsc);
+        }
+    }
+#endif
+}
+
+// Current reading of the timing clock
+unsigned long long perf_read_ticks() {
+    return perf_clock_start();
+}
+
+// Convert a count of clock ticks to milliseconds
+double perf_ticks_to_ms(unsigned long long ticks) {
+    return ticks * perf_monitor.ns_per_tick / 1000000.0;
+}
+
+// Get the handle for a metric, creating it if needed -- call once and keep the handle (-1 if full)
+int perf_register_metric(const char* metric_name) {
+    pthread_mutex_lock(&perf_lock);
+    int handle = -1;
+    for (int i = 0; i < perf_monitor.metric_count && handle < 0; i++) {
         if (strcmp(perf_monitor.metrics[i].name, metric_name) == 0) {
-            metric = &perf_monitor.metrics[i];
-            break;
+            handle = i;
         }
     }
-    
-    if (!metric && perf_monitor.metric_count < 50) {
-        metric = &perf_monitor.metrics[perf_monitor.metric_count++];
+    if (handle < 0 && perf_monitor.metric_count < PERF_MAX_METRICS) {
+        perf_clock_init();
+        PerfMetric *metric = &perf_monitor.metrics[perf_monitor.metric_count];
+        memset(metric, 0, sizeof(PerfMetric));
         strncpy(metric->name, metric_name, sizeof(metric->name) - 1);
         metric->name[sizeof(metric->name) - 1] = '\0';
-        metric->min_time = duration;
-        metric->max_time = duration;
+        handle = perf_monitor.metric_count++;
     }
-    
-    if (metric) {
-        metric->total_time += duration;
-        metric->call_count++;
-        if (duration < metric->min_time) metric->min_time = duration;
-        if (duration > metric->max_time) metric->max_time = duration;
-        
-        // Log to file if available
-        if (perf_monitor.log_file) {
-            fprintf(perf_monitor.log_file, "%.3f,%s,%.4f,%zu\n",
-                    end_time - perf_monitor.program_start_time,
-                    metric_name, duration, get_memory_usage_kb());
-            fflush(perf_monitor.log_file);
+    pthread_mutex_unlock(&perf_lock);
+    return handle;
+}
+
+// Give this thread its own timings the first time it times something -- NULL once PERF_MAX_THREADS have them
+static PerfThreadTimings *claim_thread_timings() {
+    if (perf_thread_refused) return NULL;
+    pthread_mutex_lock(&perf_lock);
+    PerfThreadTimings *timings = NULL;
+    if (perf_thread_count < PERF_MAX_THREADS) {
+        timings = calloc(1, sizeof(PerfThreadTimings));
+        if (timings) {
+            timings->paths[0] = (PerfPath){-1, -1, -1, -1, 0};
+            timings->path_count = 1;
+            perf_threads[perf_thread_count++] = timings;
+        }
+    }
+    pthread_mutex_unlock(&perf_lock);
+    perf_thread = timings;
+    perf_thread_refused = (timings == NULL);
+    return timings;
+}
+
+// Find (or add) the path reached by nesting a metric inside another path of a path table -- -1 if it is full
+static int child_path(PerfPath *paths, int *path_count, int parent, int metric) {
+    if (parent < 0) return -1;
+    int child = paths[parent].first_child;
+    while (child >= 0) {
+        if (paths[child].metric == metric) return child;
+        child = paths[child].next_sibling;
+    }
+    if (*path_count >= PERF_MAX_PATHS) return -1;
+
+    child = (*path_count)++;
+    paths[child] = (PerfPath){metric, parent, -1, paths[parent].first_child, 0};
+    paths[parent].first_child = child;
+    return child;
+}
+
+// Start timing a metric by handle -- pushes it on this thread's timer stack, nested inside any running timing
+void perf_start(int handle) {
+    if (handle < 0 || perf_depth >= PERF_MAX_DEPTH) return;
+    PerfThreadTimings *timings = (perf_thread != NULL) ? perf_thread : claim_thread_timings();
+    if (timings == NULL) return;
+    PerfFrame *frame = &perf_stack[perf_depth];
+    frame->metric = handle;
+    frame->path = child_path(timings->paths, &timings->path_count, (perf_depth > 0) ? perf_stack[perf_depth - 1].path : 0, handle);
+    frame->child_ticks = 0;
+    perf_depth++;
+    frame->hw_valid = perf_monitor.hw_counters && hw_counters_read(frame->hw_start);
+    frame->start_ticks = perf_clock_start();
+}
+
+// Stop timing a metric by handle -- timings must nest, so any left running inside it are dropped
+void perf_stop(int handle) {
+    unsigned long long end_ticks = perf_clock_stop();
+    unsigned long long hw_end[HwCounterCount];
+    bool hw_valid = perf_monitor.hw_counters && hw_counters_read(hw_end);
+    if (handle < 0 || perf_thread == NULL) return;
+
+    int depth = perf_depth - 1;
+    while (depth >= 0 && perf_stack[depth].metric != handle) depth--;
+    if (depth < 0) return;
+    PerfFrame *frame = &perf_stack[depth];
+    perf_depth = depth;
+
+    // Inclusive time counts towards the enclosing timing's children, exclusive time is what's left of ours
+    unsigned long long duration = end_ticks - frame->start_ticks;
+    unsigned long long self = (duration > frame->child_ticks) ? duration - frame->child_ticks : 0;
+    if (depth > 0) {
+        perf_stack[depth - 1].child_ticks += duration;
+    }
+    if (frame->path >= 0) {
+        perf_thread->paths[frame->path].self_ticks += self;
+    }
+
+    PerfMetric *metric = &perf_thread->metrics[handle];
+    if (metric->call_count == 0 || duration < metric->min_ticks) metric->min_ticks = duration;
+    if (metric->call_count == 0 || duration > metric->max_ticks) metric->max_ticks = duration;
+    metric->total_ticks += duration;
+    metric->self_ticks += self;
+    metric->call_count++;
+    if (hw_valid && frame->hw_valid) {
+        for (int i = 0; i < HwCounterCount; i++) {
+            metric->hw[i] += hw_end[i] - frame->hw_start[i];
+        }
+        metric->hw_calls++;
+    }
+    perf_hist_record(&metric->histogram, duration);
+
+    if (trace_active()) {
+        trace_record(TraceTiming, handle, end_ticks, duration, 0);
+    }
+}
+
+// Sum every thread's timings into perf_monitor's metrics and paths -- done before reporting. Threads still timing
+// may be partway through an update, so collect once the timed work has finished
+void perf_collect() {
+    pthread_mutex_lock(&perf_lock);
+    reset_metrics(perf_monitor.metrics, perf_monitor.metric_count);
+    perf_monitor.paths[0] = (PerfPath){-1, -1, -1, -1, 0};
+    perf_monitor.path_count = 1;
+
+    for (int t = 0; t < perf_thread_count; t++) {
+        PerfThreadTimings *timings = perf_threads[t];
+        for (int i = 0; i < perf_monitor.metric_count; i++) {
+            PerfMetric *from = &timings->metrics[i];
+            PerfMetric *into = &perf_monitor.metrics[i];
+            if (from->call_count == 0) continue;
+            if (into->call_count == 0 || from->min_ticks < into->min_ticks) into->min_ticks = from->min_ticks;
+            if (into->call_count == 0 || from->max_ticks > into->max_ticks) into->max_ticks = from->max_ticks;
+            into->total_ticks += from->total_ticks;
+            into->self_ticks += from->self_ticks;
+            into->call_count += from->call_count;
+            into->memory_used += from->memory_used;
+            for (int j = 0; j < HwCounterCount; j++) {
+                into->hw[j] += from->hw[j];
+            }
+            into->hw_calls += from->hw_calls;
+            perf_hist_merge(&into->histogram, &from->histogram);
+        }
+
+        // A path is always added after its parent, so walking in order maps every parent before its children
+        int mapped[PERF_MAX_PATHS];
+        mapped[0] = 0;
+        for (int i = 1; i < timings->path_count; i++) {
+            PerfPath *path = &timings->paths[i];
+            mapped[i] = child_path(perf_monitor.paths, &perf_monitor.path_count, mapped[path->parent], path->metric);
+            if (mapped[i] >= 0) {
+                perf_monitor.paths[mapped[i]].self_ticks += path->self_ticks;
+            }
         }
     }
+    pthread_mutex_unlock(&perf_lock);
+}
+
+// Position of the highest set bit of a non-zero value
+static int highest_bit(unsigned long long value) {
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanReverse64(&index, value);
+    return (int)index;
+#else
+    return 63 - __builtin_clzll(value);
+#endif
+}
+
+// Bucket a value falls in -- exact below SUB_COUNT, then SUB_COUNT/2 buckets per power of two
+static int hist_bucket(unsigned long long value) {
+    if (value < PERF_HIST_SUB_COUNT) return (int)value;
+    if (value >= (1ULL << PERF_HIST_MAX_BITS)) value = (1ULL << PERF_HIST_MAX_BITS) - 1;
+    int shift = highest_bit(value) - (PERF_HIST_SUB_BITS - 1);
+    int sub = (int)(value >> shift) - PERF_HIST_SUB_COUNT / 2;
+    return PERF_HIST_SUB_COUNT + (shift - 1) * (PERF_HIST_SUB_COUNT / 2) + sub;
+}
+
+// Value reported for a bucket -- the middle of its range
+static unsigned long long hist_bucket_value(int bucket) {
+    if (bucket < PERF_HIST_SUB_COUNT) return bucket;
+    int shift = (bucket - PERF_HIST_SUB_COUNT) / (PERF_HIST_SUB_COUNT / 2) + 1;
+    int sub = (bucket - PERF_HIST_SUB_COUNT) % (PERF_HIST_SUB_COUNT / 2) + PERF_HIST_SUB_COUNT / 2;
+    return ((unsigned long long)sub << shift) + (1ULL << (shift - 1));
+}
+
+// Count a value in a histogram
+void perf_hist_record(PerfHistogram *hist, unsigned long long value) {
+    hist->counts[hist_bucket(value)]++;
+    hist->total++;
+}
+
+// Add one histogram's counts to another, e.g. to combine per-thread histograms
+void perf_hist_merge(PerfHistogram *into, const PerfHistogram *from) {
+    for (int i = 0; i < PERF_HIST_BUCKETS; i++) {
+        into->counts[i] += from->counts[i];
+    }
+    into->total += from->total;
+}
+
+// Value at a percentile (0-100) of everything recorded
+unsigned long long perf_hist_percentile(const PerfHistogram *hist, double percentile) {
+    if (hist->total == 0) return 0;
+    unsigned long long rank = (unsigned long long)(percentile / 100.0 * hist->total + 0.999999);
+    if (rank < 1) rank = 1;
+    if (rank > hist->total) rank = hist->total;
+
+    unsigned long long seen = 0;
+    for (int i = 0; i < PERF_HIST_BUCKETS; i++) {
+        seen += hist->counts[i];
+        if (seen >= rank) return hist_bucket_value(i);
+    }
+    return hist_bucket_value(PERF_HIST_BUCKETS - 1);
+}
+
+// Percentile of a metric's timings in milliseconds
+static double percentile_ms(const PerfMetric *m, double percentile) {
+    return perf_ticks_to_ms(perf_hist_percentile(&m->histogram, percentile));
+}
+
+// Start timing a block of code logic by name -- looks the metric up, so prefer handles on hot paths
+void perf_start_timing(const char* metric_name) {
+    perf_start(perf_register_metric(metric_name));
+}
+
+// Denote end of a block that we have been timing
+void perf_end_timing(const char* metric_name) {
+    perf_stop(perf_register_metric(metric_name));
 }
 
 void perf_log_memory(const char* operation) {
@@ -147,51 +496,159 @@ void perf_log_memory(const char* operation) {
     
     printf("[MEMORY] %s: %zu KB at %.3f ms\n", operation, memory_kb, current_time);
     
-    if (perf_monitor.log_file) {
-        fprintf(perf_monitor.log_file, "%.3f,%s_memory,0,%zu\n", 
-                current_time, operation, memory_kb);
-        fflush(perf_monitor.log_file);
+    if (trace_active()) {
+        char name[64];
+        snprintf(name, sizeof(name), "%s_memory", operation);
+        trace_record(TraceMemory, perf_register_metric(name), perf_read_ticks(), 0, memory_kb);
+    }
+}
+
+// Print one ratio of hardware counts for the summary, or n/a if a counter it needs isn't available -- marked with
+// a * when a count was scaled because the kernel multiplexed the counter
+static void print_hw_ratio(unsigned long long top, unsigned long long bottom, int top_counter, int bottom_counter, int width, double scale) {
+    bool available = hw_counter_enabled(top_counter) && (bottom_counter < 0 || hw_counter_enabled(bottom_counter));
+    bool scaled = hw_counter_multiplexed(top_counter) || (bottom_counter >= 0 && hw_counter_multiplexed(bottom_counter));
+    if (!available || bottom == 0) {
+        printf(" %*s", width, "n/a");
+    } else {
+        printf(" %*.2f%s", width - 1, (double)top / bottom * scale, scaled ? "*" : " ");
     }
 }
 
 // Display metrics calculated through program running in neat table
 void perf_print_summary() {
+    perf_collect();
     double total_runtime = get_time_ms() - perf_monitor.program_start_time;
     
     printf("\n=== PERFORMANCE SUMMARY ===\n");
     printf("Total Runtime: %.2f ms\n", total_runtime);
     printf("Final Memory Usage: %zu KB\n", get_memory_usage_kb());
+    if (perf_monitor.log_filename[0] != '\0') {
+        printf("Trace Events Dropped: %llu\n", trace_dropped());
+    }
+    if (perf_monitor.clock_source == PerfClockTsc) {
+        printf("Timing Clock: invariant TSC (%.3f GHz)\n", 1.0 / perf_monitor.ns_per_tick);
+    } else {
+        printf("Timing Clock: monotonic clock\n");
+    }
     printf("\nOperation Performance:\n");
-    printf("%-25s %10s %10s %10s %10s %10s\n", 
-           "Operation", "Calls", "Total(ms)", "Avg(ms)", "Min(ms)", "Max(ms)");
-    printf("------------------------------------------------------------------------------------\n");
+    printf("%-25s %10s %10s %10s %10s %10s %10s\n", 
+           "Operation", "Calls", "Total(ms)", "Self(ms)", "Avg(ms)", "Min(ms)", "Max(ms)");
+    printf("-----------------------------------------------------------------------------------------------\n");
     
     for (int i = 0; i < perf_monitor.metric_count; i++) {
         PerfMetric *m = &perf_monitor.metrics[i];
-        double avg_time = m->call_count > 0 ? m->total_time / m->call_count : 0;
+        if (m->call_count == 0) continue;
+        double total_time = perf_ticks_to_ms(m->total_ticks);
         
-        printf("%-25s %10d %10.2f %10.4f %10.4f %10.4f\n",
-               m->name, m->call_count, m->total_time, avg_time, m->min_time, m->max_time);
+        printf("%-25s %10d %10.2f %10.2f %10.4f %10.4f %10.4f\n", m->name, m->call_count, total_time,
+               perf_ticks_to_ms(m->self_ticks), total_time / m->call_count,
+               perf_ticks_to_ms(m->min_ticks), perf_ticks_to_ms(m->max_ticks));
+    }
+
+    printf("\nLatency Percentiles:\n");
+    printf("%-25s %10s %10s %10s %10s %10s\n", 
+           "Operation", "p50(us)", "p90(us)", "p99(us)", "p99.9(us)", "p99.99(us)");
+    printf("------------------------------------------------------------------------------------\n");
+    for (int i = 0; i < perf_monitor.metric_count; i++) {
+        PerfMetric *m = &perf_monitor.metrics[i];
+        if (m->call_count == 0) continue;
+        printf("%-25s %10.3f %10.3f %10.3f %10.3f %10.3f\n", m->name,
+               percentile_ms(m, 50.0) * 1000.0, percentile_ms(m, 90.0) * 1000.0, percentile_ms(m, 99.0) * 1000.0,
+               percentile_ms(m, 99.9) * 1000.0, percentile_ms(m, 99.99) * 1000.0);
+    }
+
+    if (perf_monitor.hw_counters) {
+        printf("\nHardware Counters (%s):\n", hw_counters_status());
+        printf("%-25s %10s %12s %12s %12s %12s %12s\n", 
+               "Operation", "IPC", "Cycles/call", "Instr/call", "L1D miss/c", "LLC miss/c", "Mispredict%");
+        printf("------------------------------------------------------------------------------------------------------\n");
+        for (int i = 0; i < perf_monitor.metric_count; i++) {
+            PerfMetric *m = &perf_monitor.metrics[i];
+            if (m->hw_calls == 0) continue;
+            printf("%-25s", m->name);
+            print_hw_ratio(m->hw[HwInstructions], m->hw[HwCycles], HwInstructions, HwCycles, 10, 1.0);
+            print_hw_ratio(m->hw[HwCycles], m->hw_calls, HwCycles, -1, 12, 1.0);
+            print_hw_ratio(m->hw[HwInstructions], m->hw_calls, HwInstructions, -1, 12, 1.0);
+            print_hw_ratio(m->hw[HwL1dMisses], m->hw_calls, HwL1dMisses, -1, 12, 1.0);
+            print_hw_ratio(m->hw[HwLlcMisses], m->hw_calls, HwLlcMisses, -1, 12, 1.0);
+            print_hw_ratio(m->hw[HwBranchMisses], m->hw[HwBranches], HwBranchMisses, HwBranches, 12, 100.0);
+            printf("\n");
+        }
+        bool scaled = false;
+        for (int i = 0; i < HwCounterCount; i++) {
+            scaled = scaled || (hw_counter_enabled(i) && hw_counter_multiplexed(i));
+        }
+        if (scaled) {
+            printf("(* counts scaled for the time the kernel multiplexed the counter off the PMU)\n");
+        }
+    }
+
+    allocStats allocs[AllocTagCount];
+    alloc_stats_read(allocs);
+    printf("\nAllocations by Subsystem:\n");
+    printf("%-25s %12s %12s %12s %12s\n", "Subsystem", "Live(KB)", "Peak(KB)", "Allocs", "Frees");
+    printf("-----------------------------------------------------------------------------\n");
+    for (int tag = 0; tag < AllocTagCount; tag++) {
+        printf("%-25s %12.1f %12.1f %12llu %12llu\n", alloc_tag_name(tag), allocs[tag].liveBytes / 1024.0,
+               allocs[tag].peakBytes / 1024.0, allocs[tag].allocations, allocs[tag].frees);
     }
     printf("\n");
 }
 
+// Start reading hardware counters (cycles, instructions, branches, cache misses) around every timing
+bool perf_enable_hw_counters() {
+    perf_monitor.hw_counters = hw_counters_open();
+    printf("Hardware counters %s\n", hw_counters_status());
+    return perf_monitor.hw_counters;
+}
+
 // Write to CSV
 void perf_save_csv(const char* filename) {
     FILE *csv = fopen(filename, "w");
     if (!csv) return;
+    perf_collect();
     
-    fprintf(csv, "operation,calls,total_ms,avg_ms,min_ms,max_ms\n");
+    fprintf(csv, "operation,calls,total_ms,avg_ms,min_ms,max_ms,p50_ms,p90_ms,p99_ms,p99_9_ms,p99_99_ms,self_ms\n");
     for (int i = 0; i < perf_monitor.metric_count; i++) {
         PerfMetric *m = &perf_monitor.metrics[i];
-        double avg_time = m->call_count > 0 ? m->total_time / m->call_count : 0;
-        fprintf(csv, "%s,%d,%.2f,%.4f,%.4f,%.4f\n",
-                m->name, m->call_count, m->total_time, avg_time, m->min_time, m->max_time);
+        if (m->call_count == 0) continue;
+        double total_time = perf_ticks_to_ms(m->total_ticks);
+        fprintf(csv, "%s,%d,%.2f,%.4f,%.4f,%.4f,%.6f,%.6f,%.6f,%.6f,%.6f,%.2f\n",
+                m->name, m->call_count, total_time, total_time / m->call_count,
+                perf_ticks_to_ms(m->min_ticks), perf_ticks_to_ms(m->max_ticks),
+                percentile_ms(m, 50.0), percentile_ms(m, 90.0), percentile_ms(m, 99.0),
+                percentile_ms(m, 99.9), percentile_ms(m, 99.99), perf_ticks_to_ms(m->self_ticks));
     }
     fclose(csv);
     printf("Performance data saved to %s\n", filename);
 }
 
+// Write the nested timings as folded stacks ("outer;inner;leaf self_ns" per line) for flamegraph.pl / speedscope
+void perf_save_folded(const char* filename) {
+    FILE *folded = fopen(filename, "w");
+    if (!folded) return;
+    perf_collect();
+
+    for (int i = 1; i < perf_monitor.path_count; i++) {
+        PerfPath *path = &perf_monitor.paths[i];
+        if (path->self_ticks == 0) continue;
+
+        // Collect the path from the leaf up, then print it root first
+        int chain[PERF_MAX_DEPTH];
+        int length = 0;
+        for (int p = i; p > 0 && length < PERF_MAX_DEPTH; p = perf_monitor.paths[p].parent) {
+            chain[length++] = perf_monitor.paths[p].metric;
+        }
+        for (int j = length - 1; j >= 0; j--) {
+            fprintf(folded, "%s%s", perf_monitor.metrics[chain[j]].name, (j > 0) ? ";" : "");
+        }
+        fprintf(folded, " %.0f\n", perf_ticks_to_ms(path->self_ticks) * 1000000.0);
+    }
+    fclose(folded);
+    printf("Folded stacks saved to %s\n", filename);
+}
+
 // Simple benchmark functions
 void benchmark_basic_operations() {
     printf("=== BASIC OPERATIONS BENCHMARK ===\n");
@@ -229,11 +686,106 @@ void benchmark_basic_operations() {
         }
     }
     perf_end_timing("tree_operations");
+
+    // Cost of timing itself -- a start/stop pair through a handle
+    int empty_handle = perf_register_metric("empty_timing");
+    perf_start_timing("timing_overhead");
+    for (int i = 0; i < iterations; i++) {
+        perf_start(empty_handle);
+        perf_stop(empty_handle);
+    }
+    perf_end_timing("timing_overhead");
     
     perf_print_summary();
     perf_cleanup();
 }
 
+// Time each streaming indicator's per-tick update
+void benchmark_indicators() {
+    printf("=== INDICATOR UPDATE BENCHMARK ===\n");
+    perf_init(NULL);
+
+    const int iterations = 1000000;
+    const int window = 1000;
+    double price = 1.35000;
+    unsigned long long state = 88172645463325252ULL;
+
+    // Pre-generate a random walk so the generator isn't timed
+    double *prices = malloc(sizeof(double) * iterations);
+    if (!prices) return;
+    for (int i = 0; i < iterations; i++) {
+        state ^= state << 13; state ^= state >> 7; state ^= state << 17;
+        price += ((long long)(state % 5) - 2) * 0.00001;
+        prices[i] = price;
+    }
+
+    movingAverage sma;
+    expMovingAverage ema;
+    rollingVariance var;
+    rollingVWAP vwap;
+    rollingExtreme low, high;
+    marketIndicators all;
+    sma_init(&sma, window, 0);
+    ema_init(&ema, window);
+    variance_init(&var, window, 0);
+    vwap_init(&vwap, window, 0);
+    extreme_init(&low, false, window, 0, window);
+    extreme_init(&high, true, window, 1000000000LL, window);
+    market_indicators_init(&all, window, 0);
+    orderLine line = {"2025-09-05", "21:59:19.654", 0, 0, 1.0, 1.0};
+    double sink = 0;
+
+    perf_start_timing("sma_update");
+    for (int i = 0; i < iterations; i++) sink += sma_update(&sma, prices[i], i * 1000000LL);
+    perf_end_timing("sma_update");
+
+    perf_start_timing("ema_update");
+    for (int i = 0; i < iterations; i++) sink += ema_update(&ema, prices[i]);
+    perf_end_timing("ema_update");
+
+    perf_start_timing("volatility_update");
+    for (int i = 0; i < iterations; i++) sink += volatility_update(&var, prices[i], i * 1000000LL);
+    perf_end_timing("volatility_update");
+
+    perf_start_timing("vwap_update");
+    for (int i = 0; i < iterations; i++) sink += vwap_update(&vwap, prices[i], 1.0, i * 1000000LL);
+    perf_end_timing("vwap_update");
+
+    perf_start_timing("rolling_min(ticks)");
+    for (int i = 0; i < iterations; i++) sink += extreme_update(&low, prices[i], i * 1000000LL);
+    perf_end_timing("rolling_min(ticks)");
+
+    perf_start_timing("rolling_max(1s time)");
+    for (int i = 0; i < iterations; i++) sink += extreme_update(&high, prices[i], i * 1000000LL);
+    perf_end_timing("rolling_max(1s time)");
+
+    perf_start_timing("market_indicators_update");
+    for (int i = 0; i < iterations; i++) {
+        line.bidPrice = prices[i];
+        line.askPrice = prices[i] + 0.00008;
+        market_indicators_update(&all, &line, i * 1000000LL);
+    }
+    perf_end_timing("market_indicators_update");
+
+    // Each metric is a single call covering every update, so report the per update cost
+    perf_collect();
+    printf("%-25s %12s\n", "Indicator", "ns/update");
+    for (int i = 0; i < perf_monitor.metric_count; i++) {
+        if (perf_monitor.metrics[i].call_count == 0) continue;
+        printf("%-25s %12.2f\n", perf_monitor.metrics[i].name, perf_ticks_to_ms(perf_monitor.metrics[i].total_ticks) * 1000000.0 / iterations);
+    }
+    printf("(checksum %.3f)\n\n", sink + extreme_value(&all.askHigh));
+
+    window_free(&sma.window);
+    window_free(&var.window);
+    window_free(&vwap.window);
+    window_free(&low.deque);
+    window_free(&high.deque);
+    market_indicators_free(&all);
+    free(prices);
+    perf_cleanup();
+}
+
 // Memory monitoring function
 void monitor_memory_usage(const char* phase) {
     static size_t last_memory = 0;
@@ -1,68 +1,148 @@
-// benchmark.h - Performance monitoring system
-#ifndef BENCHMARK_H
-#define BENCHMARK_H
-
-#include <stdio.h>
-#include <stdlib.h>
-#include <string.h>
-#include <time.h>
-
-#ifdef _WIN32
-    #include <winsock2.h>
-    #include <windows.h>
-    #include <psapi.h>
-    // Link required Windows libraries
-    #pragma comment(lib, "psapi.lib")
-    #pragma comment(lib, "kernel32.lib")
-#else
-    #include <sys/time.h>
-    #include <sys/resource.h>
-    #include <unistd.h>
-#endif
-
-// Performance metrics structure
-typedef struct {
-    char name[64];
-    double total_time;
-    int call_count;
-    double min_time;
-    double max_time;
-    long memory_used;
-} PerfMetric;
-
-// Performance monitor
-typedef struct {
-    PerfMetric metrics[50];
-    int metric_count;
-    double program_start_time;
-    FILE *log_file;
-} PerfMonitor;
-
-// Global performance monitor
-extern PerfMonitor perf_monitor;
-
-// Function prototypes
-void perf_init(const char* log_filename);
-void perf_cleanup();
-double get_time_ms();
-size_t get_memory_usage_kb();
-void perf_start_timing(const char* metric_name);
-void perf_end_timing(const char* metric_name);
-void perf_log_memory(const char* operation);
-void perf_print_summary();
-void perf_save_csv(const char* filename);
-void monitor_memory_usage(const char* phase);
-
-// Convenience macros
-#define PERF_TIME_BLOCK(name) \
-    perf_start_timing(name); \
-    do
-
-#define PERF_TIME_END() \
-    while(0); \
-    perf_end_timing(__FUNCTION__)
-
-#define PERF_FUNCTION_START() perf_start_timing(__FUNCTION__)
-#define PERF_FUNCTION_END() perf_end_timing(__FUNCTION__)
-
+// benchmark.h - Performance monitoring system
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include "perf_counters.h"
+#include "alloc_track.h"
+
+#ifdef _WIN32
+    #include <winsock2.h>
+    #include <windows.h>
+    #include <psapi.h>
+    // Link required Windows libraries
+    #pragma comment(lib, "psapi.lib")
+    #pragma comment(lib, "kernel32.lib")
+#else
+    #include <sys/time.h>
+    #include <sys/resource.h>
+    #include <unistd.h>
+#endif
+
+// Clocks the perf monitor can time with -- the TSC is used when the CPU says it is invariant
+typedef enum {PerfClockMonotonic, PerfClockTsc} PerfClockSource;
+
+#define PERF_MAX_METRICS 50
+#define PERF_MAX_DEPTH 32           // Deepest nesting of timings per thread
+#define PERF_MAX_PATHS 512          // Distinct call paths kept for folded stack output
+#define PERF_MAX_THREADS 64         // Threads that can keep timings -- any more are not timed
+
+// Log-linear histogram layout -- values below 2^SUB_BITS are exact, larger ones land in buckets
+// 1/64th of their power of two wide (under 0.8% error reporting the middle), up to 2^MAX_BITS clock ticks
+#define PERF_HIST_SUB_BITS 7
+#define PERF_HIST_SUB_COUNT (1 << PERF_HIST_SUB_BITS)
+#define PERF_HIST_MAX_BITS 44
+#define PERF_HIST_BUCKETS (PERF_HIST_SUB_COUNT + (PERF_HIST_MAX_BITS - PERF_HIST_SUB_BITS) * (PERF_HIST_SUB_COUNT / 2))
+
+// Fixed size latency histogram -- O(1) record, histograms of the same layout can be added together
+typedef struct {
+    unsigned long long counts[PERF_HIST_BUCKETS];
+    unsigned long long total;
+} PerfHistogram;
+
+// Performance metrics structure
+typedef struct {
+    char name[64];
+    unsigned long long total_ticks; // Inclusive time, kept in raw clock ticks -- see perf_ticks_to_ms()
+    unsigned long long self_ticks;  // Exclusive time -- total less the time in nested timings
+    int call_count;
+    unsigned long long min_ticks;
+    unsigned long long max_ticks;
+    long memory_used;
+    PerfHistogram histogram;        // Every duration in clock ticks
+    unsigned long long hw[HwCounterCount];  // Hardware events counted inside the timings
+    int hw_calls;                   // Timings the hardware counters could be read for
+} PerfMetric;
+
+// One node of the tree of nested timings -- a path from the outermost timing down to this metric
+typedef struct {
+    int metric;                     // -1 for the root
+    int parent;
+    int first_child;
+    int next_sibling;
+    unsigned long long self_ticks;
+} PerfPath;
+
+// Timings kept by one thread -- only that thread writes them, so timing needs no locks
+typedef struct {
+    PerfMetric metrics[PERF_MAX_METRICS];   // Indexed by handle, names are only kept in perf_monitor
+    PerfPath paths[PERF_MAX_PATHS];
+    int path_count;
+} PerfThreadTimings;
+
+// Performance monitor -- metrics and paths hold every thread's timings summed by perf_collect()
+typedef struct {
+    PerfMetric metrics[PERF_MAX_METRICS];
+    int metric_count;
+    double program_start_time;
+    unsigned long long program_start_ticks;
+    PerfClockSource clock_source;
+    double ns_per_tick;             // 0 until the clock has been chosen and calibrated
+    bool hw_counters;               // Read hardware counters around every timing
+    char log_filename[256];          // CSV log written from the binary trace at perf_cleanup()
+    char trace_filename[272];
+    PerfPath paths[PERF_MAX_PATHS];
+    int path_count;
+} PerfMonitor;
+
+// Global performance monitor
+extern PerfMonitor perf_monitor;
+
+// Function prototypes
+void perf_init(const char* log_filename);
+void perf_cleanup();
+double get_time_ms();
+size_t get_memory_usage_kb();
+void perf_clock_init();
+double perf_ticks_to_ms(unsigned long long ticks);
+unsigned long long perf_read_ticks();
+int perf_register_metric(const char* metric_name);
+void perf_start(int handle);
+void perf_stop(int handle);
+void perf_collect();
+void perf_hist_record(PerfHistogram *hist, unsigned long long value);
+void perf_hist_merge(PerfHistogram *into, const PerfHistogram *from);
+unsigned long long perf_hist_percentile(const PerfHistogram *hist, double percentile);
+void perf_start_timing(const char* metric_name);
+void perf_end_timing(const char* metric_name);
+void perf_log_memory(const char* operation);
+void perf_print_summary();
+void perf_save_csv(const char* filename);
+void perf_save_folded(const char* filename);
+bool perf_enable_hw_counters();
+void monitor_memory_usage(const char* phase);
+void benchmark_basic_operations();
+void benchmark_indicators();
+
+// Convenience macros -- each call site registers its metric once and keeps the handle in a static, which is
+// atomic as any thread may be first to get there
+#define PERF_HANDLE(handle, name) \
+    static atomic_int handle##_cached = -1; \
+    int handle = atomic_load_explicit(&handle##_cached, memory_order_relaxed); \
+    if (handle < 0) { \
+        handle = perf_register_metric(name); \
+        atomic_store_explicit(&handle##_cached, handle, memory_order_relaxed); \
+    }
+
+#define PERF_TIME_BLOCK(name) \
+    do { \
+        PERF_HANDLE(perf_block_handle, name); \
+        perf_start(perf_block_handle); \
+        do
+
+#define PERF_TIME_END() \
+        while(0); \
+        perf_stop(perf_block_handle); \
+    } while(0)
+
+#define PERF_FUNCTION_START() \
+    PERF_HANDLE(perf_function_handle, __FUNCTION__); \
+    perf_start(perf_function_handle)
+#define PERF_FUNCTION_END() perf_stop(perf_function_handle)
+
 #endif // BENCHMARK_H
\ No newline at end of file
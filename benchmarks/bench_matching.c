@@ -0,0 +1,248 @@
+// bench_matching.c - Synthetic order-flow benchmark for the matching engine
+// Build (from repo root):
+//   gcc -Wall -O3 -I. -o bench_matching.exe benchmarks/bench_matching.c order_book.c matching.c strategy.c portfolio_tracker.c latency.c data_read.c benchmark.c perf_trace.c perf_counters.c alloc_track.c indicators.c risk.c journal.c -lm -lpthread
+// Usage: ./bench_matching.exe [seed] [operations_per_run]
+#include "order_book.h"
+#include "matching.h"
+#include "strategy.h"
+#include "benchmark.h"
+
+// Globals normally defined in main.c
+SIM_LOCAL treeStruct bidTree = {Bid, NULL, 0};
+SIM_LOCAL treeStruct askTree = {Ask, NULL, 0};
+SIM_LOCAL userAccount user = {0, 0};
+
+// Size of one price step in the synthetic book
+#define TICK_SIZE 0.00001
+
+// Operation types produced by the generator
+typedef enum {OpBookUpdate, OpLimitOrder, OpMarketOrder, OpCancel, OpMatchAll, OpCount} benchOp;
+static const char *opNames[OpCount] = {"insert_node", "create_order(limit)", "valid_match(market)", "cancel_order", "match_all_orders"};
+
+// Relative weights of each operation in a generated flow
+typedef struct {
+    const char *name;
+    int bookUpdates;
+    int limitOrders;
+    int marketOrders;
+    int cancels;
+    int matchAlls;
+} flowMix;
+
+// Latency samples for one operation type
+typedef struct {
+    double *samples;
+    int count;
+    double total;
+} opSamples;
+
+static unsigned long long rngState;
+
+// Order ID counter from strategy.c -- reset between runs
+extern SIM_LOCAL int countID;
+
+
+// xorshift64* -- seeded so every run sees the same flow
+static unsigned long long next_random() {
+    rngState ^= rngState >> 12;
+    rngState ^= rngState << 25;
+    rngState ^= rngState >> 27;
+    return rngState * 0x2545F4914F6CDD1DULL;
+}
+
+
+// Uniform double in [0, 1)
+static double next_unit() {
+    return (next_random() >> 11) * (1.0 / 9007199254740992.0);
+}
+
+
+// Allocate a book node ready for insert_node
+static node *make_node(double price, double volume) {
+    node *new_node = tracked_malloc(AllocBookNodes, sizeof(node));
+    if (!new_node) {
+        printf("Error Allocating Memory!\n");
+        exit(-1);
+    }
+    *new_node = (node){price, volume, Red, NULL, NULL, NULL};
+    return new_node;
+}
+
+
+// Fill both sides of the book with a given number of levels around a mid price
+static void prefill_book(double mid, int depth) {
+    // Insert worst levels first so later, better levels don't wipe them out
+    for (int i = depth; i > 0; i--) {
+        insert_node(&bidTree, make_node(mid - i * TICK_SIZE, 1.0 + (next_random() % 8)));
+        insert_node(&askTree, make_node(mid + i * TICK_SIZE, 1.0 + (next_random() % 8)));
+    }
+}
+
+
+// Record a single timed sample
+static void record_sample(opSamples *ops, benchOp op, double start) {
+    double duration_ns = (get_time_ms() - start) * 1000000.0;
+    ops[op].samples[ops[op].count++] = duration_ns;
+    ops[op].total += duration_ns;
+}
+
+
+// Sort helper for percentile calculation
+static int compare_doubles(const void *a, const void *b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+
+// Nearest-rank percentile from a sorted sample set
+static double percentile(const double *sorted, int count, double pct) {
+    if (count == 0) {
+        return 0;
+    }
+    int rank = (int)(pct / 100.0 * count + 0.5);
+    if (rank < 1) rank = 1;
+    if (rank > count) rank = count;
+    return sorted[rank - 1];
+}
+
+
+// Drive the engine with one generated flow at a given depth
+static void run_flow(const flowMix *mix, int depth, int operations, unsigned long long seed) {
+    rngState = seed;
+    set_max_tree_size(depth);
+    initHashTable();
+    free_tree(&bidTree);
+    free_tree(&askTree);
+    user = (userAccount){1e9, 1e9};
+
+    double mid = 1.35000;
+    prefill_book(mid, depth);
+
+    opSamples ops[OpCount] = {0};
+    for (int i = 0; i < OpCount; i++) {
+        ops[i].samples = malloc(sizeof(double) * operations);
+    }
+    int totalWeight = mix->bookUpdates + mix->limitOrders + mix->marketOrders + mix->cancels + mix->matchAlls;
+    int liveIDs[ORDER_TABLE_SIZE];
+    int liveCount = 0;
+
+    double runStart = get_time_ms();
+    for (int i = 0; i < operations; i++) {
+        int pick = next_random() % totalWeight;
+        double start;
+
+        // Once the order table is full, cancel instead of placing more orders
+        if (freeSpace <= 1 && pick >= mix->bookUpdates && pick < mix->bookUpdates + mix->limitOrders + mix->marketOrders) {
+            pick = mix->bookUpdates + mix->limitOrders + mix->marketOrders;
+        }
+
+        if ((pick -= mix->bookUpdates) < 0) {
+            // Random-walk the touch like the real feed does, one side at a time
+            mid += ((int)(next_random() % 5) - 2) * TICK_SIZE;
+            bool bidSide = next_random() & 1;
+            double offset = (next_random() % 3) * TICK_SIZE;
+            node *update = make_node(bidSide ? mid - TICK_SIZE - offset : mid + TICK_SIZE + offset, 1.0 + (next_random() % 8));
+            start = get_time_ms();
+            insert_node(bidSide ? &bidTree : &askTree, update);
+            record_sample(ops, OpBookUpdate, start);
+
+        } else if ((pick -= mix->limitOrders) < 0) {
+            // Limit order somewhere around the touch -- may rest or cross
+            tradeType side = (next_random() & 1) ? Bid : Ask;
+            double price = mid + ((int)(next_random() % (2 * depth + 1)) - depth) * TICK_SIZE;
+            start = get_time_ms();
+            order *newOrder = create_order(side, price, 0.1 + next_unit() * 0.4, Limit);
+            record_sample(ops, OpLimitOrder, start);
+            if (newOrder && liveCount < ORDER_TABLE_SIZE) {
+                liveIDs[liveCount++] = newOrder->orderID;
+            }
+
+        } else if ((pick -= mix->marketOrders) < 0) {
+            // Market order matched immediately against the opposite side
+            tradeType side = (next_random() & 1) ? Bid : Ask;
+            treeStruct *opposite = (side == Bid) ? &askTree : &bidTree;
+            node *touch = find_best_node(opposite);
+            if (touch == NULL) {
+                continue;
+            }
+            order *newOrder = create_order(side, touch->price, 0.1 + next_unit() * 0.4, Market);
+            if (newOrder == NULL) {
+                continue;
+            }
+            start = get_time_ms();
+            int outcome = valid_match(opposite, newOrder, &user);
+            record_sample(ops, OpMarketOrder, start);
+            // Unfilled market orders are dropped, partially filled ones keep resting
+            if (outcome < 0) {
+                delete_order_byPointer(newOrder);
+            } else if (outcome == 0 && liveCount < ORDER_TABLE_SIZE) {
+                liveIDs[liveCount++] = newOrder->orderID;
+            }
+
+        } else if ((pick -= mix->cancels) < 0) {
+            // Cancel a random order we placed earlier (it may already have filled)
+            if (liveCount == 0) {
+                continue;
+            }
+            int slot = next_random() % liveCount;
+            start = get_time_ms();
+            delete_order_byID(liveIDs[slot]);
+            record_sample(ops, OpCancel, start);
+            liveIDs[slot] = liveIDs[--liveCount];
+
+        } else {
+            start = get_time_ms();
+            match_all_orders();
+            record_sample(ops, OpMatchAll, start);
+        }
+        // Keep both sides of the book populated
+        if (bidTree.size == 0 || askTree.size == 0) {
+            prefill_book(mid, depth);
+        }
+    }
+    double runTime = get_time_ms() - runStart;
+
+    printf("\n[%s] depth=%d ops=%d seed=%llu -> %.0f ops/s overall\n", mix->name, depth, operations, seed, operations / (runTime / 1000.0));
+    printf("%-22s %10s %12s %10s %10s %10s %10s\n", "Operation", "Count", "Ops/s", "Avg(ns)", "p50(ns)", "p99(ns)", "p99.9(ns)");
+    printf("------------------------------------------------------------------------------------------\n");
+    for (int i = 0; i < OpCount; i++) {
+        if (ops[i].count == 0) {
+            continue;
+        }
+        qsort(ops[i].samples, ops[i].count, sizeof(double), compare_doubles);
+        printf("%-22s %10d %12.0f %10.1f %10.1f %10.1f %10.1f\n", opNames[i], ops[i].count,
+               ops[i].count / (ops[i].total / 1e9), ops[i].total / ops[i].count,
+               percentile(ops[i].samples, ops[i].count, 50.0),
+               percentile(ops[i].samples, ops[i].count, 99.0),
+               percentile(ops[i].samples, ops[i].count, 99.9));
+    }
+    for (int i = 0; i < OpCount; i++) {
+        free(ops[i].samples);
+    }
+    freeHashTable();
+    countID = 0;
+}
+
+
+int main(int argc, char *argv[]) {
+    unsigned long long seed = (argc > 1) ? strtoull(argv[1], NULL, 10) : 12345;
+    int operations = (argc > 2) ? atoi(argv[2]) : 200000;
+
+    // Flow mixes -- weights are relative
+    flowMix mixes[] = {
+        {"book-heavy",   80, 10,  5,  3, 2},
+        {"order-heavy",  40, 30, 15, 10, 5},
+        {"match-heavy",  50, 20,  5,  5, 20},
+    };
+    int depths[] = {5, 10, 50, 200};
+
+    printf("=== MATCHING ENGINE BENCHMARK ===\n");
+    for (size_t m = 0; m < sizeof(mixes) / sizeof(mixes[0]); m++) {
+        for (size_t d = 0; d < sizeof(depths) / sizeof(depths[0]); d++) {
+            run_flow(&mixes[m], depths[d], operations, seed);
+        }
+    }
+    free_tree(&bidTree);
+    free_tree(&askTree);
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,711 @@
+// bench_micro.c - Microbenchmarks for the order book, matching and data reading hot paths
+// Build (from repo root):
+//   gcc -Wall -O3 -I. -o bench_micro.exe benchmarks/bench_micro.c order_book.c matching.c strategy.c portfolio_tracker.c latency.c data_read.c benchmark.c perf_trace.c perf_counters.c alloc_track.c indicators.c risk.c journal.c -lm -lpthread
+// Usage: ./bench_micro.exe [--reps N] [--warmup N] [--batch N] [--filter name] [--json out.json]
+//                          [--baseline base.json] [--threshold pct]
+#include "order_book.h"
+#include "matching.h"
+#include "strategy.h"
+#include "data_read.h"
+#include "benchmark.h"
+#include <math.h>
+
+// Globals normally defined in main.c
+SIM_LOCAL treeStruct bidTree = {Bid, NULL, 0};
+SIM_LOCAL treeStruct askTree = {Ask, NULL, 0};
+SIM_LOCAL userAccount user = {0, 0};
+
+// Size of one price step in the synthetic book
+#define TICK_SIZE 0.00001
+#define MID_PRICE 1.35000
+
+// Open orders one matching case places -- leaves room in the ORDER_TABLE_SIZE slot order table
+#define MAX_BENCH_ORDERS 100
+
+// Deepest book a case builds
+#define MAX_BENCH_DEPTH 1000
+
+// Levels per cluster and ticks between clusters in a clustered book
+#define CLUSTER_LEVELS 8
+#define CLUSTER_GAP_TICKS 50
+
+// Most ticks between neighbouring levels in a gapped book
+#define MAX_GAP_TICKS 10
+
+// Lines in the generated tick file read by read_next_line
+#define READ_LINES 4096
+
+// Most results a baseline file can hold
+#define MAX_RESULTS 64
+
+// How the levels of a synthetic book are spaced from the touch
+typedef enum {
+    LayoutUniform,          // One level every tick
+    LayoutGapped,           // Random 1 to MAX_GAP_TICKS tick gaps between levels
+    LayoutClustered,        // Runs of CLUSTER_LEVELS adjacent levels CLUSTER_GAP_TICKS apart
+    LayoutCount
+} priceLayout;
+
+static const char *layoutNames[LayoutCount] = {"uniform", "gapped", "clustered"};
+
+// Time spent in a case's timed section and the operations it covered
+typedef struct {
+    unsigned long long ticks;
+    long ops;
+} timedRun;
+
+// One microbenchmark -- run() prepares its own state untimed and times only the operation
+typedef struct microCase {
+    const char *name;
+    int depth;              // Book levels (0 when the book isn't used)
+    priceLayout layout;
+    int orders;             // Resting orders the matching cases place (0 when orders aren't used)
+    timedRun (*run)(const struct microCase *mc, long batch);
+} microCase;
+
+// Summary of a case's repetitions, in ns per operation -- name, depth, layout and orders identify the case
+typedef struct {
+    char name[64];
+    int depth;
+    priceLayout layout;
+    int orders;
+    double mean;
+    double stddev;
+    double min;
+    double p50;
+    double p90;
+    double max;
+} microResult;
+
+static unsigned long long rngState = 12345;
+static FILE *tickFile = NULL;
+
+// Results are written here so the compiler can't drop the calls being timed
+static volatile double sink;
+
+// Ticks from the mid to each level (from 1) of the book reset_book last built
+static int levelTicks[MAX_BENCH_DEPTH + 1];
+
+// Order ID counter from strategy.c -- reset between runs
+extern SIM_LOCAL int countID;
+
+
+// xorshift64* -- fixed seed so every run sees the same inputs
+static unsigned long long next_random() {
+    rngState ^= rngState >> 12;
+    rngState ^= rngState << 25;
+    rngState ^= rngState >> 27;
+    return rngState * 0x2545F4914F6CDD1DULL;
+}
+
+
+// Allocate a book node ready for insert_node
+static node *make_node(double price, double volume) {
+    node *new_node = tracked_malloc(AllocBookNodes, sizeof(node));
+    if (!new_node) {
+        printf("Error Allocating Memory!\n");
+        exit(-1);
+    }
+    *new_node = (node){price, volume, Red, NULL, NULL, NULL};
+    return new_node;
+}
+
+
+// Allocate an order for the user without going through the latency queue
+static order *make_order(tradeType type, double price, double volume, orderType fill) {
+    order *newOrder = tracked_malloc(AllocOrders, sizeof(order));
+    orderData *info = tracked_malloc(AllocOrders, sizeof(orderData));
+    if (!newOrder || !info) {
+        printf("Error Allocating Memory!\n");
+        exit(-1);
+    }
+    *info = (orderData){type, price, volume, fill, -1, &user};
+    *newOrder = (order){countID++, info};
+    return newOrder;
+}
+
+
+// Work out how far each level sits from the mid -- gapped books use their own fixed seed so every repetition gets
+// the same ladder and the shared generator's sequence is left alone
+static void layout_levels(priceLayout layout, int depth) {
+    unsigned long long gapState = 0x9E3779B97F4A7C15ULL;
+    levelTicks[0] = 0;
+    for (int level = 1; level <= depth; level++) {
+        int step = 1;
+        if (layout == LayoutGapped) {
+            gapState ^= gapState >> 12;
+            gapState ^= gapState << 25;
+            gapState ^= gapState >> 27;
+            step = 1 + (int)((gapState * 0x2545F4914F6CDD1DULL) % MAX_GAP_TICKS);
+        } else if (layout == LayoutClustered && level > 1 && (level - 1) % CLUSTER_LEVELS == 0) {
+            step = CLUSTER_GAP_TICKS;
+        }
+        levelTicks[level] = levelTicks[level - 1] + step;
+    }
+}
+
+
+// Price of the level'th best level (from 1) of a book made by reset_book
+static double level_price(treeStruct *tree, int level) {
+    return (tree->type == Bid) ? MID_PRICE - levelTicks[level] * TICK_SIZE : MID_PRICE + levelTicks[level] * TICK_SIZE;
+}
+
+
+// Empty both sides of the book and the order table, then fill one side with depth levels spaced by layout
+static void reset_book(treeStruct *tree, int depth, priceLayout layout, double volume) {
+    set_max_tree_size(depth);
+    free_tree(&bidTree);
+    free_tree(&askTree);
+    freeHashTable();
+    initHashTable();
+    countID = 0;
+    user = (userAccount){1e9, 1e9};
+
+    // Worst levels first so later, better levels don't wipe them out
+    layout_levels(layout, depth);
+    for (int i = depth; i > 0; i--) {
+        insert_node(tree, make_node(level_price(tree, i), volume));
+    }
+}
+
+
+//! Cases
+// New best bids arriving on a full book -- each insert also trims the worst level
+static timedRun run_insert_node(const microCase *mc, long batch) {
+    int depth = mc->depth;
+    timedRun result = {0, 0};
+    node **nodes = malloc(sizeof(node*) * batch);
+    if (!nodes) {
+        printf("Error Allocating Memory!\n");
+        exit(-1);
+    }
+    reset_book(&bidTree, depth, mc->layout, 1.0);
+    for (long i = 0; i < batch; i++) {
+        nodes[i] = make_node(MID_PRICE + i * TICK_SIZE, 1.0 + (next_random() % 8));
+    }
+
+    unsigned long long start = perf_read_ticks();
+    for (long i = 0; i < batch; i++) {
+        insert_node(&bidTree, nodes[i]);
+    }
+    result.ticks = perf_read_ticks() - start;
+    result.ops = batch;
+    free(nodes);
+    return result;
+}
+
+
+// Remove every level of a book in random order
+static timedRun run_delete_node(const microCase *mc, long batch) {
+    int depth = mc->depth;
+    timedRun result = {0, 0};
+    node **nodes = malloc(sizeof(node*) * depth);
+    if (!nodes) {
+        printf("Error Allocating Memory!\n");
+        exit(-1);
+    }
+    while (result.ops < batch) {
+        reset_book(&bidTree, depth, mc->layout, 1.0);
+        for (int i = 0; i < depth; i++) {
+            nodes[i] = search_tree(&bidTree, level_price(&bidTree, i + 1));
+        }
+        for (int i = depth - 1; i > 0; i--) {
+            int j = next_random() % (i + 1);
+            node *temp = nodes[i];
+            nodes[i] = nodes[j];
+            nodes[j] = temp;
+        }
+
+        unsigned long long start = perf_read_ticks();
+        for (int i = 0; i < depth; i++) {
+            delete_node(&bidTree, nodes[i]);
+        }
+        result.ticks += perf_read_ticks() - start;
+        result.ops += depth;
+    }
+    free(nodes);
+    return result;
+}
+
+
+// A new best half way down the book -- one call removes the better half of the levels
+static timedRun run_recursive_delete(const microCase *mc, long batch) {
+    int depth = mc->depth;
+    timedRun result = {0, 0};
+    long calls = batch / depth + 1;
+    for (long i = 0; i < calls; i++) {
+        reset_book(&bidTree, depth, mc->layout, 1.0);
+        node pivot = {level_price(&bidTree, depth / 2 + 1), 1.0, Red, NULL, NULL, NULL};
+
+        unsigned long long start = perf_read_ticks();
+        recursive_delete(&bidTree, bidTree.root, &pivot);
+        result.ticks += perf_read_ticks() - start;
+        result.ops++;
+    }
+    return result;
+}
+
+
+// Look up the touch of a full book
+static timedRun run_find_best_node(const microCase *mc, long batch) {
+    int depth = mc->depth;
+    timedRun result = {0, 0};
+    reset_book(&bidTree, depth, mc->layout, 1.0);
+
+    double total = 0;
+    unsigned long long start = perf_read_ticks();
+    for (long i = 0; i < batch; i++) {
+        total += find_best_node(&bidTree)->price;
+    }
+    result.ticks = perf_read_ticks() - start;
+    result.ops = batch;
+    sink = total;
+    return result;
+}
+
+
+// Walk a full book from the touch down, one step per operation
+static timedRun run_find_next_best(const microCase *mc, long batch) {
+    int depth = mc->depth;
+    timedRun result = {0, 0};
+    reset_book(&bidTree, depth, mc->layout, 1.0);
+
+    double total = 0;
+    node *curr = NULL;
+    unsigned long long start = perf_read_ticks();
+    for (long i = 0; i < batch; i++) {
+        curr = (curr == NULL) ? find_best_node(&bidTree) : find_next_best(&bidTree, curr);
+        if (curr != NULL) {
+            total += curr->volume;
+        }
+    }
+    result.ticks = perf_read_ticks() - start;
+    result.ops = batch;
+    sink = total;
+    return result;
+}
+
+
+// Look up random levels of a full book by price
+static timedRun run_search_tree(const microCase *mc, long batch) {
+    int depth = mc->depth;
+    timedRun result = {0, 0};
+    double *prices = malloc(sizeof(double) * batch);
+    if (!prices) {
+        printf("Error Allocating Memory!\n");
+        exit(-1);
+    }
+    reset_book(&bidTree, depth, mc->layout, 1.0);
+    for (long i = 0; i < batch; i++) {
+        prices[i] = level_price(&bidTree, 1 + next_random() % depth);
+    }
+
+    double total = 0;
+    unsigned long long start = perf_read_ticks();
+    for (long i = 0; i < batch; i++) {
+        node *found = search_tree(&bidTree, prices[i]);
+        if (found != NULL) {
+            total += found->volume;
+        }
+    }
+    result.ticks = perf_read_ticks() - start;
+    result.ops = batch;
+    sink = total;
+    free(prices);
+    return result;
+}
+
+
+// Resting market buys each taking a quarter of the best ask level, so every fourth one empties a level
+static timedRun run_valid_match(const microCase *mc, long batch) {
+    int depth = mc->depth;
+    timedRun result = {0, 0};
+    order *orders[MAX_BENCH_ORDERS];
+    // Stop before the book runs out
+    int perBook = (mc->orders < MAX_BENCH_ORDERS) ? mc->orders : MAX_BENCH_ORDERS;
+    if (perBook > depth * 4 - 1) {
+        perBook = depth * 4 - 1;
+    }
+
+    while (result.ops < batch) {
+        reset_book(&askTree, depth, mc->layout, 1.0);
+        for (int i = 0; i < perBook; i++) {
+            orders[i] = make_order(Bid, level_price(&askTree, 1), 0.25, Market);
+            insert_order_byPointer(orders[i]);
+        }
+
+        int filled = 0;
+        unsigned long long start = perf_read_ticks();
+        for (int i = 0; i < perBook; i++) {
+            filled += valid_match(&askTree, orders[i], &user);
+        }
+        result.ticks += perf_read_ticks() - start;
+        result.ops += perBook;
+        sink = filled;
+    }
+    return result;
+}
+
+
+// An order table of resting bids with a fifth able to cross the ask side
+static timedRun run_match_all_orders(const microCase *mc, long batch) {
+    int depth = mc->depth;
+    timedRun result = {0, 0};
+    int orders = (mc->orders < MAX_BENCH_ORDERS) ? mc->orders : MAX_BENCH_ORDERS;
+    long calls = batch / MAX_BENCH_ORDERS + 1;
+    for (long i = 0; i < calls; i++) {
+        reset_book(&askTree, depth, mc->layout, 1.0);
+        for (int j = 0; j < orders; j++) {
+            bool crosses = (next_random() % 5) == 0;
+            double price = crosses ? level_price(&askTree, depth) : MID_PRICE - (1 + next_random() % 50) * TICK_SIZE;
+            insert_order_byPointer(make_order(Bid, price, crosses ? 0.25 : 1.0, Limit));
+        }
+
+        unsigned long long start = perf_read_ticks();
+        match_all_orders();
+        result.ticks += perf_read_ticks() - start;
+        result.ops++;
+    }
+    return result;
+}
+
+
+// Resting limit bids bigger than the whole ask side -- the first pass runs the book out on a partial fill, the second
+// must find nothing left to match. Exits if a used-up level is still there to be filled again
+static timedRun run_book_sweep(const microCase *mc, long batch) {
+    int depth = mc->depth;
+    timedRun result = {0, 0};
+    int orders = (mc->orders < MAX_BENCH_ORDERS) ? mc->orders : MAX_BENCH_ORDERS;
+    long calls = batch / MAX_BENCH_ORDERS + 1;
+    for (long i = 0; i < calls; i++) {
+        reset_book(&askTree, depth, mc->layout, 1.0);
+        for (int j = 0; j < orders; j++) {
+            insert_order_byPointer(make_order(Bid, level_price(&askTree, depth), depth + 1.0, Limit));
+        }
+        double startBalance = user.baseCurrencyBalance;
+
+        unsigned long long start = perf_read_ticks();
+        match_all_orders();
+        double swept = user.baseCurrencyBalance - startBalance;
+        match_all_orders();
+        result.ticks += perf_read_ticks() - start;
+        result.ops += 2;
+
+        if (askTree.root != NULL || fabs(swept - depth) > 1e-9 || user.baseCurrencyBalance != startBalance + swept) {
+            printf("book_sweep: filled %.2f then %.2f against a %d lot book\n", swept, user.baseCurrencyBalance - startBalance - swept, depth);
+            exit(1);
+        }
+    }
+    return result;
+}
+
+
+// Parse lines of a generated tick file
+static timedRun run_read_next_line(const microCase *mc, long batch) {
+    (void) mc;
+    timedRun result = {0, 0};
+    orderLine line;
+    double total = 0;
+    while (result.ops < batch) {
+        rewind(tickFile);
+
+        long lines = 0;
+        unsigned long long start = perf_read_ticks();
+        while (read_next_line(tickFile, &line) > 0) {
+            total += line.bidPrice;
+            lines++;
+        }
+        result.ticks += perf_read_ticks() - start;
+        result.ops += lines;
+    }
+    sink = total;
+    return result;
+}
+
+
+// Write a tick file in the same layout as the real data for read_next_line
+static FILE *make_tick_file() {
+    FILE *fp = tmpfile();
+    if (!fp) {
+        perror("Error creating tick file");
+        exit(-1);
+    }
+    double bid = MID_PRICE;
+    for (int i = 0; i < READ_LINES; i++) {
+        bid += ((int)(next_random() % 5) - 2) * TICK_SIZE;
+        int ms = i * 250;
+        fprintf(fp, "2025-09-05,21:%02d:%02d.%03d,%.5f,%.5f,%.1f,%.1f\n", (ms / 60000) % 60, (ms / 1000) % 60, ms % 1000,
+                bid, bid + (1 + next_random() % 10) * TICK_SIZE, 0.9 * (1 + next_random() % 6), 0.9 * (1 + next_random() % 6));
+    }
+    return fp;
+}
+
+
+//! Statistics and Reporting
+// Sort helper for percentile calculation
+static int compare_doubles(const void *a, const void *b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+
+// Nearest-rank percentile from a sorted sample set
+static double percentile(const double *sorted, int count, double pct) {
+    if (count == 0) {
+        return 0;
+    }
+    int rank = (int)(pct / 100.0 * count + 0.5);
+    if (rank < 1) rank = 1;
+    if (rank > count) rank = count;
+    return sorted[rank - 1];
+}
+
+
+// Run a case's warmup and repetitions, summarising ns per operation across the repetitions
+static microResult run_case(const microCase *mc, int warmup, int reps, long batch) {
+    microResult result;
+    memset(&result, 0, sizeof(result));
+    snprintf(result.name, sizeof(result.name), "%s", mc->name);
+    result.depth = mc->depth;
+    result.layout = mc->layout;
+    result.orders = mc->orders;
+
+    for (int i = 0; i < warmup; i++) {
+        mc->run(mc, batch);
+    }
+    double *samples = malloc(sizeof(double) * reps);
+    if (!samples) {
+        printf("Error Allocating Memory!\n");
+        exit(-1);
+    }
+    double sum = 0;
+    for (int i = 0; i < reps; i++) {
+        timedRun timed = mc->run(mc, batch);
+        samples[i] = perf_ticks_to_ms(timed.ticks) * 1000000.0 / timed.ops;
+        sum += samples[i];
+    }
+    result.mean = sum / reps;
+    double squares = 0;
+    for (int i = 0; i < reps; i++) {
+        squares += (samples[i] - result.mean) * (samples[i] - result.mean);
+    }
+    result.stddev = (reps > 1) ? sqrt(squares / (reps - 1)) : 0;
+
+    qsort(samples, reps, sizeof(double), compare_doubles);
+    result.min = samples[0];
+    result.p50 = percentile(samples, reps, 50.0);
+    result.p90 = percentile(samples, reps, 90.0);
+    result.max = samples[reps - 1];
+    free(samples);
+    return result;
+}
+
+
+// Write every result as JSON -- one result per line, which is what read_baseline expects
+static int save_json(const char *filename, const microResult *results, int count, int warmup, int reps, long batch) {
+    FILE *fp = fopen(filename, "w");
+    if (!fp) {
+        perror("Error opening JSON file");
+        return 1;
+    }
+    fprintf(fp, "{\n  \"benchmark\": \"bench_micro\",\n  \"unit\": \"ns/op\",\n");
+    fprintf(fp, "  \"warmup\": %d,\n  \"repetitions\": %d,\n  \"batch\": %ld,\n  \"results\": [\n", warmup, reps, batch);
+    for (int i = 0; i < count; i++) {
+        const microResult *r = &results[i];
+        fprintf(fp, "    {\"name\": \"%s\", \"depth\": %d, \"layout\": \"%s\", \"orders\": %d, \"mean\": %.3f, \"stddev\": %.3f, \"min\": %.3f, \"p50\": %.3f, \"p90\": %.3f, \"max\": %.3f}%s\n",
+                r->name, r->depth, layoutNames[r->layout], r->orders, r->mean, r->stddev, r->min, r->p50, r->p90, r->max, (i + 1 < count) ? "," : "");
+    }
+    fprintf(fp, "  ]\n}\n");
+    fclose(fp);
+    printf("\nResults saved to %s\n", filename);
+    return 0;
+}
+
+
+// Read the results of an earlier --json run, returning how many were found (-1 if the file can't be read). Results
+// saved before cases had a layout or order count are read as uniform books with no orders
+static int read_baseline(const char *filename, microResult *results, int maxResults) {
+    FILE *fp = fopen(filename, "r");
+    if (!fp) {
+        perror("Error opening baseline file");
+        return -1;
+    }
+    char row[512];
+    int count = 0;
+    while (count < maxResults && fgets(row, sizeof(row), fp)) {
+        char *name = strstr(row, "\"name\": \"");
+        char *depth = strstr(row, "\"depth\": ");
+        char *p50 = strstr(row, "\"p50\": ");
+        if (!name || !depth || !p50) {
+            continue;
+        }
+        microResult *r = &results[count];
+        memset(r, 0, sizeof(*r));
+        char *layout = strstr(row, "\"layout\": \"");
+        char *orders = strstr(row, "\"orders\": ");
+        r->layout = LayoutUniform;
+        for (int i = 0; layout != NULL && i < LayoutCount; i++) {
+            size_t length = strlen(layoutNames[i]);
+            if (strncmp(layout + 11, layoutNames[i], length) == 0 && layout[11 + length] == '"') {
+                r->layout = (priceLayout) i;
+            }
+        }
+        if (orders == NULL || sscanf(orders + 10, "%d", &r->orders) != 1) {
+            r->orders = 0;
+        }
+        if (sscanf(name + 9, "%63[^\"]", r->name) == 1 && sscanf(depth + 9, "%d", &r->depth) == 1 &&
+            sscanf(p50 + 7, "%lf", &r->p50) == 1) {
+            count++;
+        }
+    }
+    fclose(fp);
+    return count;
+}
+
+
+// Compare medians against a baseline, returning how many cases got slower by more than threshold percent
+static int compare_baseline(const microResult *results, int count, const microResult *baseline, int baselineCount, double threshold) {
+    int regressions = 0;
+    printf("\nBaseline comparison (p50, regression threshold %.1f%%)\n", threshold);
+    printf("%-20s %6s %-10s %6s %12s %12s %9s  %s\n", "Benchmark", "Depth", "Layout", "Orders", "Base(ns)", "Now(ns)", "Change", "Status");
+    printf("--------------------------------------------------------------------------------------------\n");
+    for (int i = 0; i < count; i++) {
+        const microResult *r = &results[i];
+        const microResult *base = NULL;
+        for (int j = 0; j < baselineCount; j++) {
+            if (strcmp(baseline[j].name, r->name) == 0 && baseline[j].depth == r->depth &&
+                baseline[j].layout == r->layout && baseline[j].orders == r->orders) {
+                base = &baseline[j];
+                break;
+            }
+        }
+        if (base == NULL || base->p50 <= 0) {
+            printf("%-20s %6d %-10s %6d %12s %12.1f %9s  %s\n", r->name, r->depth, layoutNames[r->layout], r->orders, "-", r->p50, "-", "new");
+            continue;
+        }
+        double change = (r->p50 - base->p50) / base->p50 * 100.0;
+        const char *status = "ok";
+        if (change > threshold) {
+            status = "REGRESSION";
+            regressions++;
+        } else if (change < -threshold) {
+            status = "faster";
+        }
+        printf("%-20s %6d %-10s %6d %12.1f %12.1f %+8.1f%%  %s\n", r->name, r->depth, layoutNames[r->layout], r->orders, base->p50, r->p50, change, status);
+    }
+    return regressions;
+}
+
+
+int main(int argc, char *argv[]) {
+    int warmup = 3;
+    int reps = 15;
+    long batch = 20000;
+    double threshold = 10.0;
+    const char *filter = NULL;
+    const char *jsonFile = NULL;
+    const char *baselineFile = NULL;
+
+    for (int i = 1; i < argc; i++) {
+        bool hasValue = i + 1 < argc;
+        if (strcmp(argv[i], "--reps") == 0 && hasValue) {
+            reps = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--warmup") == 0 && hasValue) {
+            warmup = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--batch") == 0 && hasValue) {
+            batch = atol(argv[++i]);
+        } else if (strcmp(argv[i], "--filter") == 0 && hasValue) {
+            filter = argv[++i];
+        } else if (strcmp(argv[i], "--json") == 0 && hasValue) {
+            jsonFile = argv[++i];
+        } else if (strcmp(argv[i], "--baseline") == 0 && hasValue) {
+            baselineFile = argv[++i];
+        } else if (strcmp(argv[i], "--threshold") == 0 && hasValue) {
+            threshold = atof(argv[++i]);
+        } else {
+            printf("Unknown option: %s\n", argv[i]);
+            return 2;
+        }
+    }
+    if (reps < 1) reps = 1;
+    if (warmup < 0) warmup = 0;
+    if (batch < 1) batch = 1;
+
+    // {name, depth, layout, orders, run}
+    microCase cases[] = {
+        {"insert_node", 10, LayoutUniform, 0, run_insert_node},
+        {"insert_node", 100, LayoutUniform, 0, run_insert_node},
+        {"insert_node", 1000, LayoutUniform, 0, run_insert_node},
+        {"delete_node", 10, LayoutUniform, 0, run_delete_node},
+        {"delete_node", 100, LayoutUniform, 0, run_delete_node},
+        {"delete_node", 1000, LayoutUniform, 0, run_delete_node},
+        {"recursive_delete", 10, LayoutUniform, 0, run_recursive_delete},
+        {"recursive_delete", 100, LayoutUniform, 0, run_recursive_delete},
+        {"recursive_delete", 1000, LayoutUniform, 0, run_recursive_delete},
+        {"find_best_node", 10, LayoutUniform, 0, run_find_best_node},
+        {"find_best_node", 1000, LayoutUniform, 0, run_find_best_node},
+        {"find_next_best", 10, LayoutUniform, 0, run_find_next_best},
+        {"find_next_best", 1000, LayoutUniform, 0, run_find_next_best},
+        {"search_tree", 10, LayoutUniform, 0, run_search_tree},
+        {"search_tree", 100, LayoutUniform, 0, run_search_tree},
+        {"search_tree", 1000, LayoutUniform, 0, run_search_tree},
+        {"search_tree", 1000, LayoutGapped, 0, run_search_tree},
+        {"search_tree", 1000, LayoutClustered, 0, run_search_tree},
+        {"valid_match", 10, LayoutUniform, 10, run_valid_match},
+        {"valid_match", 100, LayoutUniform, 10, run_valid_match},
+        {"valid_match", 100, LayoutUniform, 50, run_valid_match},
+        {"valid_match", 100, LayoutUniform, 100, run_valid_match},
+        {"valid_match", 100, LayoutGapped, 100, run_valid_match},
+        {"valid_match", 100, LayoutClustered, 100, run_valid_match},
+        {"match_all_orders", 10, LayoutUniform, 100, run_match_all_orders},
+        {"match_all_orders", 100, LayoutUniform, 10, run_match_all_orders},
+        {"match_all_orders", 100, LayoutUniform, 50, run_match_all_orders},
+        {"match_all_orders", 100, LayoutUniform, 100, run_match_all_orders},
+        {"match_all_orders", 100, LayoutGapped, 100, run_match_all_orders},
+        {"match_all_orders", 100, LayoutClustered, 100, run_match_all_orders},
+        {"book_sweep", 10, LayoutUniform, 10, run_book_sweep},
+        {"book_sweep", 100, LayoutGapped, 10, run_book_sweep},
+        {"read_next_line", 0, LayoutUniform, 0, run_read_next_line},
+    };
+    int caseCount = sizeof(cases) / sizeof(cases[0]);
+
+    perf_clock_init();
+    tickFile = make_tick_file();
+    microResult results[MAX_RESULTS];
+    int resultCount = 0;
+
+    printf("=== MICROBENCHMARKS ===\n");
+    printf("warmup=%d reps=%d batch=%ld (ns per operation across repetitions)\n\n", warmup, reps, batch);
+    printf("%-20s %6s %-10s %6s %10s %9s %10s %10s %10s %10s\n", "Benchmark", "Depth", "Layout", "Orders", "Mean", "StdDev", "Min", "p50", "p90", "Max");
+    printf("----------------------------------------------------------------------------------------------------------\n");
+    for (int i = 0; i < caseCount && resultCount < MAX_RESULTS; i++) {
+        if (filter != NULL && strstr(cases[i].name, filter) == NULL) {
+            continue;
+        }
+        microResult *r = &results[resultCount++];
+        *r = run_case(&cases[i], warmup, reps, batch);
+        printf("%-20s %6d %-10s %6d %10.1f %9.1f %10.1f %10.1f %10.1f %10.1f\n", r->name, r->depth, layoutNames[r->layout], r->orders,
+               r->mean, r->stddev, r->min, r->p50, r->p90, r->max);
+    }
+    fclose(tickFile);
+    free_tree(&bidTree);
+    free_tree(&askTree);
+    freeHashTable();
+
+    if (jsonFile != NULL && save_json(jsonFile, results, resultCount, warmup, reps, batch) != 0) {
+        return 2;
+    }
+    if (baselineFile != NULL) {
+        microResult baseline[MAX_RESULTS];
+        int baselineCount = read_baseline(baselineFile, baseline, MAX_RESULTS);
+        if (baselineCount < 0) {
+            return 2;
+        }
+        int regressions = compare_baseline(results, resultCount, baseline, baselineCount, threshold);
+        if (regressions > 0) {
+            printf("\n%d benchmark(s) regressed by more than %.1f%%\n", regressions, threshold);
+            return 1;
+        }
+    }
+    return 0;
+}
\ No newline at end of file
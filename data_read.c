@@ -1,4 +1,5 @@
 #include "data_read.h"
+#include "alloc_track.h"
 
 // Define the length of a line in CSV input
 #define MAX_ROW_LENGTH 80
@@ -34,4 +35,88 @@ int read_next_line(FILE *fp, orderLine *orderObj) {
             return -1;
         }
     return 1;
+}
+
+
+// Convert a tick's date and time strings into nanoseconds since the Unix epoch
+long long tick_timestamp_ns(const orderLine *orderObj) {
+    int year, month, day, hour, minute;
+    double seconds;
+    if (sscanf(orderObj->date, "%d-%d-%d", &year, &month, &day) != 3 ||
+        sscanf(orderObj->time, "%d:%d:%lf", &hour, &minute, &seconds) != 3) {
+        return -1;
+    }
+    // Days since epoch from a civil date (shift year so it starts in March)
+    year -= (month <= 2);
+    long long era = (year >= 0 ? year : year - 399) / 400;
+    long long yearOfEra = year - era * 400;
+    long long dayOfYear = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    long long dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+    long long days = era * 146097 + dayOfEra - 719468;
+
+    long long wholeSeconds = days * 86400LL + hour * 3600LL + minute * 60LL;
+    return wholeSeconds * 1000000000LL + (long long)(seconds * 1000000000.0 + 0.5);
+}
+
+
+// Read a whole CSV into memory once so it can be replayed many times
+tickData load_tick_file(const char *filename) {
+    tickData ticks = {NULL, NULL, NULL, NULL, 0, 0};
+    size_t capacity = 1 << 16;
+    ticks.lines = tracked_malloc(AllocIngest, sizeof(orderLine) * capacity);
+    ticks.timestamps = tracked_malloc(AllocIngest, sizeof(long long) * capacity);
+    if (!ticks.lines || !ticks.timestamps) {
+        printf("Error Allocating Memory!\n");
+        exit(-1);
+    }
+
+    FILE *fp = open_data_file(filename);
+    orderLine line;
+    while (read_next_line(fp, &line) > 0) {
+        // Double storage when full
+        if (ticks.count == capacity) {
+            orderLine *grownLines = tracked_realloc(AllocIngest, ticks.lines, sizeof(orderLine) * capacity, sizeof(orderLine) * capacity * 2);
+            long long *grownTimes = tracked_realloc(AllocIngest, ticks.timestamps, sizeof(long long) * capacity, sizeof(long long) * capacity * 2);
+            capacity *= 2;
+            if (!grownLines || !grownTimes) {
+                printf("Error Allocating Memory!\n");
+                exit(-1);
+            }
+            ticks.lines = grownLines;
+            ticks.timestamps = grownTimes;
+        }
+        ticks.lines[ticks.count] = line;
+        ticks.timestamps[ticks.count] = tick_timestamp_ns(&line);
+        ticks.count++;
+    }
+    fclose(fp);
+    ticks.capacity = capacity;
+
+    // Copy prices into their own contiguous columns
+    ticks.bidPrices = tracked_malloc(AllocIngest, sizeof(double) * (ticks.count + 1));
+    ticks.askPrices = tracked_malloc(AllocIngest, sizeof(double) * (ticks.count + 1));
+    if (!ticks.bidPrices || !ticks.askPrices) {
+        printf("Error Allocating Memory!\n");
+        exit(-1);
+    }
+    for (size_t i = 0; i < ticks.count; i++) {
+        ticks.bidPrices[i] = ticks.lines[i].bidPrice;
+        ticks.askPrices[i] = ticks.lines[i].askPrice;
+    }
+    return ticks;
+}
+
+
+// Free a loaded tick file
+void free_tick_data(tickData *ticks) {
+    tracked_free(AllocIngest, ticks->lines, sizeof(orderLine) * ticks->capacity);
+    tracked_free(AllocIngest, ticks->timestamps, sizeof(long long) * ticks->capacity);
+    tracked_free(AllocIngest, ticks->bidPrices, sizeof(double) * (ticks->count + 1));
+    tracked_free(AllocIngest, ticks->askPrices, sizeof(double) * (ticks->count + 1));
+    ticks->lines = NULL;
+    ticks->timestamps = NULL;
+    ticks->bidPrices = NULL;
+    ticks->askPrices = NULL;
+    ticks->count = 0;
+    ticks->capacity = 0;
 }
\ No newline at end of file
@@ -17,8 +17,21 @@ typedef struct {
     double askVolume;
 } orderLine;
 
+// Whole tick file held in memory -- shared read-only between simulator instances
+typedef struct {
+    orderLine *lines;
+    long long *timestamps;      // Parsed tick times in ns since epoch
+    double *bidPrices;          // Price columns for vectorised scans over the ticks
+    double *askPrices;
+    size_t count;
+    size_t capacity;            // Lines allocated for lines and timestamps
+} tickData;
+
 // Function declarations
 FILE *open_data_file(const char *filename);
 int read_next_line(FILE *fp, orderLine *orderObj);
+long long tick_timestamp_ns(const orderLine *orderObj);
+tickData load_tick_file(const char *filename);
+void free_tick_data(tickData *ticks);
 
 #endif
\ No newline at end of file
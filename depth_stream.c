@@ -0,0 +1,107 @@
+#include "depth_stream.h"
+#include <math.h>
+
+
+// Copy one side's best levels into a snapshot
+static int capture_side(treeStruct *tree, depthLevel *levels, int maxLevels) {
+    int count = 0;
+    for (node *level = find_best_node(tree); level != NULL && count < maxLevels; level = find_next_best(tree, level)) {
+        levels[count].priceTicks = (int32_t) lround(level->price / TELEMETRY_DEPTH_PRICE_TICK);
+        levels[count].volume = (float) level->volume;
+        count++;
+    }
+    return count;
+}
+
+
+// Capture the top levels of each side of the book -- a walk of at most levels nodes per side
+void depth_capture(depthSnapshot *snapshot, treeStruct *bids, treeStruct *asks, int levels, long long line) {
+    if (levels > DEPTH_MAX_LEVELS) {
+        levels = DEPTH_MAX_LEVELS;
+    }
+    snapshot->line = line;
+    snapshot->bidCount = capture_side(bids, snapshot->bids, levels);
+    snapshot->askCount = capture_side(asks, snapshot->asks, levels);
+}
+
+
+// Set up an encoder -- the first update is always a full snapshot
+void depth_encoder_init(depthEncoder *encoder, int snapshotEvery) {
+    memset(encoder, 0, sizeof(*encoder));
+    encoder->snapshotEvery = (snapshotEvery > 0) ? snapshotEvery : 1;
+}
+
+
+// Write every level of one side as part of a full snapshot
+static int encode_snapshot_side(const depthLevel *levels, int count, uint32_t line, tradeType side, depthRecord *records) {
+    for (int i = 0; i < count; i++) {
+        records[i] = (depthRecord){line, levels[i].priceTicks, levels[i].volume, (uint8_t) side, DEPTH_SNAPSHOT, 0};
+    }
+    return count;
+}
+
+
+// Write the levels of one side that were added, removed or changed volume -- both lists are in book order
+// (best first), so one merge pass finds them
+static int encode_delta_side(const depthLevel *previous, int previousCount, const depthLevel *current, int currentCount,
+                             uint32_t line, tradeType side, depthRecord *records) {
+    int written = 0;
+    int i = 0, j = 0;
+    // Bids are best first from the highest price, asks from the lowest
+    int direction = (side == Bid) ? -1 : 1;
+    while (i < previousCount || j < currentCount) {
+        long long order = 0;
+        if (i == previousCount) {
+            order = 1;
+        } else if (j == currentCount) {
+            order = -1;
+        } else {
+            order = (long long) direction * ((long long) previous[i].priceTicks - current[j].priceTicks);
+        }
+
+        if (order < 0) {
+            // Level no longer in the book
+            records[written++] = (depthRecord){line, previous[i].priceTicks, 0.0f, (uint8_t) side, 0, 0};
+            i++;
+        } else if (order > 0) {
+            // New level
+            records[written++] = (depthRecord){line, current[j].priceTicks, current[j].volume, (uint8_t) side, 0, 0};
+            j++;
+        } else {
+            if (previous[i].volume != current[j].volume) {
+                records[written++] = (depthRecord){line, current[j].priceTicks, current[j].volume, (uint8_t) side, 0, 0};
+            }
+            i++;
+            j++;
+        }
+    }
+    return written;
+}
+
+
+// Encode a snapshot against the last one -- only changed levels, except every snapshotEvery updates when the whole
+// book is sent so a reader that lost packets can resync. Returns how many records were written (at most
+// DEPTH_MAX_RECORDS), which is 0 if nothing changed
+int depth_encode(depthEncoder *encoder, const depthSnapshot *snapshot, depthRecord *records) {
+    uint32_t line = (uint32_t) snapshot->line;
+    int written = 0;
+
+    if (!encoder->primed || encoder->sinceSnapshot >= encoder->snapshotEvery) {
+        written += encode_snapshot_side(snapshot->bids, snapshot->bidCount, line, Bid, records);
+        written += encode_snapshot_side(snapshot->asks, snapshot->askCount, line, Ask, records + written);
+        // An empty book still has to clear the reader's copy
+        if (written == 0) {
+            records[written++] = (depthRecord){line, 0, 0.0f, Bid, DEPTH_SNAPSHOT, 0};
+        }
+        records[0].flags |= DEPTH_SNAPSHOT_START;
+        encoder->primed = true;
+        encoder->sinceSnapshot = 0;
+    } else {
+        const depthSnapshot *last = &encoder->last;
+        written += encode_delta_side(last->bids, last->bidCount, snapshot->bids, snapshot->bidCount, line, Bid, records);
+        written += encode_delta_side(last->asks, last->askCount, snapshot->asks, snapshot->askCount, line, Ask, records + written);
+        encoder->sinceSnapshot++;
+    }
+    encoder->last = *snapshot;
+    return written;
+}
\ No newline at end of file
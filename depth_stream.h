@@ -0,0 +1,47 @@
+#ifndef DEPTH_STREAM_H
+#define DEPTH_STREAM_H
+
+// Standard includes
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+// Including other project headers
+#include "order_book.h"
+#include "telemetry.h"
+
+// Define the most levels per side a depth snapshot holds -- keeps the copy the trading thread makes bounded
+#define DEPTH_MAX_LEVELS 20
+#define DEPTH_MAX_RECORDS (4 * DEPTH_MAX_LEVELS)    // Most records one update can encode to
+
+// One price level as captured -- 8 bytes
+typedef struct {
+    int32_t priceTicks;
+    float volume;
+} depthLevel;
+
+// Top levels of both sides of the book on one tick, best first -- 336 bytes
+typedef struct {
+    int64_t line;
+    int32_t bidCount;
+    int32_t askCount;
+    depthLevel bids[DEPTH_MAX_LEVELS];
+    depthLevel asks[DEPTH_MAX_LEVELS];
+} depthSnapshot;
+
+// Last book sent, so each update only needs the levels that changed
+typedef struct {
+    depthSnapshot last;
+    bool primed;
+    int snapshotEvery;          // Updates between full snapshots
+    int sinceSnapshot;
+} depthEncoder;
+
+// Function declarations
+void depth_capture(depthSnapshot *snapshot, treeStruct *bids, treeStruct *asks, int levels, long long line);
+void depth_encoder_init(depthEncoder *encoder, int snapshotEvery);
+int depth_encode(depthEncoder *encoder, const depthSnapshot *snapshot, depthRecord *records);
+
+#endif
\ No newline at end of file
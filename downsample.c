@@ -0,0 +1,127 @@
+#include "downsample.h"
+
+
+// Set up an aggregator -- bucketNs > 0 selects time buckets, otherwise every bucketTicks ticks make a bar
+void bar_aggregator_init(barAggregator *aggregator, int bucketTicks, long long bucketNs) {
+    memset(aggregator, 0, sizeof(*aggregator));
+    aggregator->bucketTicks = (bucketTicks > 0) ? bucketTicks : 1;
+    aggregator->bucketNs = (bucketNs > 0) ? bucketNs : 0;
+}
+
+
+// Start a new bar on a tick
+static void open_bar(barAggregator *aggregator, const tickRecord *tick) {
+    barRecord *bar = &aggregator->current;
+    bar->firstLine = tick->line;
+    bar->startTime = (aggregator->bucketNs > 0) ? tick->timestamp - tick->timestamp % aggregator->bucketNs : tick->timestamp;
+    bar->bidOpen = bar->bidHigh = bar->bidLow = tick->bid;
+    bar->askOpen = bar->askHigh = bar->askLow = tick->ask;
+    aggregator->ticks = 0;
+}
+
+
+// Add a tick -- true (with the bar in finished) when it completes a bar. A time bucket is completed by the
+// first tick after it, which then opens the next bar
+bool bar_aggregator_add(barAggregator *aggregator, const tickRecord *tick, barRecord *finished) {
+    bool done = false;
+    if (aggregator->ticks > 0 && aggregator->bucketNs > 0 && tick->timestamp - aggregator->current.startTime >= aggregator->bucketNs) {
+        *finished = aggregator->current;
+        aggregator->ticks = 0;
+        done = true;
+    }
+    if (aggregator->ticks == 0) {
+        open_bar(aggregator, tick);
+    }
+
+    barRecord *bar = &aggregator->current;
+    if (tick->bid > bar->bidHigh) bar->bidHigh = tick->bid;
+    if (tick->bid < bar->bidLow) bar->bidLow = tick->bid;
+    if (tick->ask > bar->askHigh) bar->askHigh = tick->ask;
+    if (tick->ask < bar->askLow) bar->askLow = tick->ask;
+    bar->bidClose = tick->bid;
+    bar->askClose = tick->ask;
+    bar->value = tick->value;
+    bar->lastLine = tick->line;
+    bar->endTime = tick->timestamp;
+    aggregator->ticks++;
+
+    if (aggregator->bucketNs == 0 && aggregator->ticks >= aggregator->bucketTicks) {
+        *finished = *bar;
+        aggregator->ticks = 0;
+        done = true;
+    }
+    return done;
+}
+
+
+// Hand back the part-filled bar, if any -- used when the data ends
+bool bar_aggregator_flush(barAggregator *aggregator, barRecord *finished) {
+    if (aggregator->ticks == 0) {
+        return false;
+    }
+    *finished = aggregator->current;
+    aggregator->ticks = 0;
+    return true;
+}
+
+
+// Largest-Triangle-Three-Buckets -- picks threshold points that keep the visual shape of the series, writing
+// their indices to selected in order and returning how many were picked. The first and last points are always
+// kept, and each bucket in between keeps the point forming the largest triangle with the point kept before it
+// and the average of the next bucket
+int lttb_reduce(const double *x, const double *y, int count, int threshold, int *selected) {
+    if (threshold >= count || threshold < 3) {
+        for (int i = 0; i < count; i++) {
+            selected[i] = i;
+        }
+        return count;
+    }
+
+    int picked = 0;
+    int previous = 0;
+    double every = (double) (count - 2) / (threshold - 2);
+    selected[picked++] = 0;
+
+    for (int bucket = 0; bucket < threshold - 2; bucket++) {
+        // Average of the next bucket (just the last point for the final bucket)
+        int nextStart = (int) ((bucket + 1) * every) + 1;
+        int nextEnd = (int) ((bucket + 2) * every) + 1;
+        if (nextEnd > count) {
+            nextEnd = count;
+        }
+        double averageX = 0, averageY = 0;
+        for (int i = nextStart; i < nextEnd; i++) {
+            averageX += x[i];
+            averageY += y[i];
+        }
+        int nextCount = nextEnd - nextStart;
+        if (nextCount > 0) {
+            averageX /= nextCount;
+            averageY /= nextCount;
+        } else {
+            averageX = x[count - 1];
+            averageY = y[count - 1];
+        }
+
+        // Point in this bucket making the largest triangle
+        int start = (int) (bucket * every) + 1;
+        int end = (int) ((bucket + 1) * every) + 1;
+        double bestArea = -1;
+        int best = start;
+        for (int i = start; i < end; i++) {
+            double area = (x[previous] - averageX) * (y[i] - y[previous]) - (x[previous] - x[i]) * (averageY - y[previous]);
+            if (area < 0) {
+                area = -area;
+            }
+            if (area > bestArea) {
+                bestArea = area;
+                best = i;
+            }
+        }
+        selected[picked++] = best;
+        previous = best;
+    }
+
+    selected[picked++] = count - 1;
+    return picked;
+}
\ No newline at end of file
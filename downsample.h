@@ -0,0 +1,28 @@
+#ifndef DOWNSAMPLE_H
+#define DOWNSAMPLE_H
+
+// Standard includes
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+// Including other project headers
+#include "telemetry.h"
+
+// Gathers ticks into bars -- tick buckets (every N ticks) or time buckets (every N ns of tick time)
+typedef struct {
+    int bucketTicks;
+    long long bucketNs;         // Time buckets if > 0, otherwise bucketTicks ticks per bar
+    barRecord current;
+    int ticks;                  // Ticks in the current bar, 0 if none is open
+} barAggregator;
+
+// Function declarations
+void bar_aggregator_init(barAggregator *aggregator, int bucketTicks, long long bucketNs);
+bool bar_aggregator_add(barAggregator *aggregator, const tickRecord *tick, barRecord *finished);
+bool bar_aggregator_flush(barAggregator *aggregator, barRecord *finished);
+int lttb_reduce(const double *x, const double *y, int count, int threshold, int *selected);
+
+#endif
\ No newline at end of file
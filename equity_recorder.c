@@ -0,0 +1,186 @@
+#include "equity_recorder.h"
+#include "alloc_track.h"
+
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+
+// Allocate a buffer aligned for large unbuffered-style writes
+static void *aligned_buffer(size_t size) {
+#ifdef _WIN32
+    void *buffer = _aligned_malloc(size, EQUITY_BUFFER_ALIGNMENT);
+#else
+    void *buffer = aligned_alloc(EQUITY_BUFFER_ALIGNMENT, size);
+#endif
+    if (!buffer) {
+        printf("Error Allocating Memory!\n");
+        exit(-1);
+    }
+    alloc_record(AllocTelemetry, size);
+    return buffer;
+}
+
+
+// Free a buffer from aligned_buffer -- size is what it was allocated with
+static void aligned_buffer_free(void *buffer, size_t size) {
+    if (buffer == NULL) {
+        return;
+    }
+    alloc_release(AllocTelemetry, size);
+#ifdef _WIN32
+    _aligned_free(buffer);
+#else
+    free(buffer);
+#endif
+}
+
+
+// Start of a column inside a block buffer
+static unsigned char *column_start(unsigned char *buffer, int blockRows, int column) {
+    return buffer + (size_t) column * blockRows * 8;
+}
+
+
+//! Equity Recorder
+// Create (truncate) an equity file, returning false if it can't be opened
+bool equity_recorder_open(equityRecorder *recorder, const char *filename) {
+    recorder->file = fopen(filename, "wb");
+    recorder->rows = 0;
+    recorder->rowsWritten = 0;
+    recorder->buffer = NULL;
+    if (!recorder->file) {
+        perror("Error opening equity file");
+        return false;
+    }
+    // The block is the write buffer, so stdio's own buffering is skipped
+    setvbuf(recorder->file, NULL, _IONBF, 0);
+    recorder->buffer = aligned_buffer((size_t) EQUITY_BLOCK_ROWS * EquityColumnCount * 8);
+
+    equityFileHeader header = {EQUITY_MAGIC, EquityColumnCount, EQUITY_BLOCK_ROWS, 0};
+    fwrite(&header, sizeof(header), 1, recorder->file);
+    return true;
+}
+
+
+// Add one tick to the current block, writing the block out once it is full
+void equity_record(equityRecorder *recorder, long long timestamp, double bid, double ask, double base, double quote, double value) {
+    if (recorder->file == NULL) {
+        return;
+    }
+    int row = recorder->rows;
+    ((int64_t*) column_start(recorder->buffer, EQUITY_BLOCK_ROWS, EquityTimestamp))[row] = timestamp;
+    ((double*) column_start(recorder->buffer, EQUITY_BLOCK_ROWS, EquityBid))[row] = bid;
+    ((double*) column_start(recorder->buffer, EQUITY_BLOCK_ROWS, EquityAsk))[row] = ask;
+    ((double*) column_start(recorder->buffer, EQUITY_BLOCK_ROWS, EquityBase))[row] = base;
+    ((double*) column_start(recorder->buffer, EQUITY_BLOCK_ROWS, EquityQuote))[row] = quote;
+    ((double*) column_start(recorder->buffer, EQUITY_BLOCK_ROWS, EquityValue))[row] = value;
+
+    if (++recorder->rows == EQUITY_BLOCK_ROWS) {
+        equity_recorder_flush(recorder);
+    }
+}
+
+
+// Write the current block -- a partial block has its columns packed together first
+void equity_recorder_flush(equityRecorder *recorder) {
+    if (recorder->file == NULL || recorder->rows == 0) {
+        return;
+    }
+    int rows = recorder->rows;
+    if (rows < EQUITY_BLOCK_ROWS) {
+        for (int column = 1; column < EquityColumnCount; column++) {
+            memmove(column_start(recorder->buffer, rows, column), column_start(recorder->buffer, EQUITY_BLOCK_ROWS, column), (size_t) rows * 8);
+        }
+    }
+    int64_t blockRows = rows;
+    fwrite(&blockRows, sizeof(blockRows), 1, recorder->file);
+    fwrite(recorder->buffer, 8, (size_t) rows * EquityColumnCount, recorder->file);
+    recorder->rowsWritten += rows;
+    recorder->rows = 0;
+}
+
+
+// Write any remaining ticks and close the file
+void equity_recorder_close(equityRecorder *recorder) {
+    if (recorder->file == NULL) {
+        return;
+    }
+    equity_recorder_flush(recorder);
+    fclose(recorder->file);
+    aligned_buffer_free(recorder->buffer, (size_t) EQUITY_BLOCK_ROWS * EquityColumnCount * 8);
+    recorder->file = NULL;
+    recorder->buffer = NULL;
+}
+
+
+//! Equity Reader
+// Open an equity file and check its header
+bool equity_reader_open(equityReader *reader, const char *filename) {
+    equityFileHeader header;
+    reader->buffer = NULL;
+    reader->file = fopen(filename, "rb");
+    if (!reader->file) {
+        perror("Error opening equity file");
+        return false;
+    }
+    if (fread(&header, sizeof(header), 1, reader->file) != 1 || header.magic != EQUITY_MAGIC || header.columns != EquityColumnCount) {
+        printf("Not an equity file: %s\n", filename);
+        fclose(reader->file);
+        reader->file = NULL;
+        return false;
+    }
+    reader->blockRows = header.blockRows;
+    reader->buffer = aligned_buffer((size_t) header.blockRows * EquityColumnCount * 8);
+    return true;
+}
+
+
+// Read the next block, returning its row count (0 at the end of the file)
+int equity_reader_next(equityReader *reader, equityBlock *block) {
+    int64_t rows;
+    if (fread(&rows, sizeof(rows), 1, reader->file) != 1 || rows <= 0 || rows > reader->blockRows) {
+        return 0;
+    }
+    if (fread(reader->buffer, 8, (size_t) rows * EquityColumnCount, reader->file) != (size_t) rows * EquityColumnCount) {
+        return 0;
+    }
+    block->rows = (int) rows;
+    block->timestamps = (int64_t*) column_start(reader->buffer, rows, EquityTimestamp);
+    block->bid = (double*) column_start(reader->buffer, rows, EquityBid);
+    block->ask = (double*) column_start(reader->buffer, rows, EquityAsk);
+    block->base = (double*) column_start(reader->buffer, rows, EquityBase);
+    block->quote = (double*) column_start(reader->buffer, rows, EquityQuote);
+    block->value = (double*) column_start(reader->buffer, rows, EquityValue);
+    return block->rows;
+}
+
+
+// Close a reader
+void equity_reader_close(equityReader *reader) {
+    if (reader->file) {
+        fclose(reader->file);
+    }
+    aligned_buffer_free(reader->buffer, (size_t) reader->blockRows * EquityColumnCount * 8);
+    reader->file = NULL;
+    reader->buffer = NULL;
+}
+
+
+// Print an equity file as CSV, returning 0 on success
+int dump_equity_file(const char *filename) {
+    equityReader reader;
+    equityBlock block;
+    if (!equity_reader_open(&reader, filename)) {
+        return 1;
+    }
+    printf("timestamp,bid,ask,base,quote,value\n");
+    while (equity_reader_next(&reader, &block) > 0) {
+        for (int i = 0; i < block.rows; i++) {
+            printf("%lld,%.6f,%.6f,%.6f,%.6f,%.6f\n", (long long) block.timestamps[i], block.bid[i], block.ask[i],
+                   block.base[i], block.quote[i], block.value[i]);
+        }
+    }
+    equity_reader_close(&reader);
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,63 @@
+#ifndef EQUITY_RECORDER_H
+#define EQUITY_RECORDER_H
+
+// Standard includes
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+// Define how many ticks are held per block -- each column of a block is written contiguously
+#define EQUITY_BLOCK_ROWS 8192
+#define EQUITY_BUFFER_ALIGNMENT 4096
+#define EQUITY_MAGIC 0x59545145     // "EQTY"
+
+// Columns stored for every tick, in file order -- all 8 bytes wide
+typedef enum {EquityTimestamp, EquityBid, EquityAsk, EquityBase, EquityQuote, EquityValue, EquityColumnCount} equityColumn;
+
+// File header -- followed by blocks of {int64 rows, rows x each column}
+typedef struct {
+    uint32_t magic;
+    uint32_t columns;
+    uint32_t blockRows;
+    uint32_t reserved;
+} equityFileHeader;
+
+// Writer holding one block of columns in a single aligned buffer
+typedef struct {
+    FILE *file;
+    unsigned char *buffer;      // Column c starts at c * EQUITY_BLOCK_ROWS * 8
+    int rows;
+    long long rowsWritten;
+} equityRecorder;
+
+// One block read back from a file -- column pointers are valid until the next read
+typedef struct {
+    int rows;
+    int64_t *timestamps;
+    double *bid;
+    double *ask;
+    double *base;
+    double *quote;
+    double *value;
+} equityBlock;
+
+// Reader for files written by an equityRecorder
+typedef struct {
+    FILE *file;
+    unsigned char *buffer;
+    int blockRows;
+} equityReader;
+
+// Function declarations
+bool equity_recorder_open(equityRecorder *recorder, const char *filename);
+void equity_record(equityRecorder *recorder, long long timestamp, double bid, double ask, double base, double quote, double value);
+void equity_recorder_flush(equityRecorder *recorder);
+void equity_recorder_close(equityRecorder *recorder);
+bool equity_reader_open(equityReader *reader, const char *filename);
+int equity_reader_next(equityReader *reader, equityBlock *block);
+void equity_reader_close(equityReader *reader);
+int dump_equity_file(const char *filename);
+
+#endif
\ No newline at end of file
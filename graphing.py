@@ -5,39 +5,166 @@ from collections import deque
 import threading
 from threading import Lock
 import time
+import struct
+import mmap
+import sys
+import numpy as np
+
+
+# Telemetry wire format -- must match telemetry.h
+TELEMETRY_MAGIC = 0x4D4C4554
+TELEMETRY_VERSION = 1
+TELEMETRY_BAR = 2
+TELEMETRY_HISTORY = 3
+HISTORY_PRICE = 0
+HISTORY_VALUE = 1
+HEADER = struct.Struct('<IHHIHH')       # magic, version, kind, sequence, count, record size
+# first line, last line, start/end time (ns), bid open/high/low/close, ask open/high/low/close, portfolio value
+BAR_RECORD = struct.Struct('<qqqqddddddddd')
+HISTORY_POINT = struct.Struct('<qddIHH')    # line, bid or value, ask, generation, series, total points
+TELEMETRY_DEPTH = 4
+DEPTH_RECORD = struct.Struct('<IifBBH')     # line, price (in DEPTH_PRICE_TICKs), volume (0 = level gone), side, flags
+DEPTH_SNAPSHOT = 0x01                       # Part of a full snapshot
+DEPTH_SNAPSHOT_START = 0x02                 # First record of a full snapshot -- clear the book, we're in sync again
+DEPTH_PRICE_TICK = 0.00001
+RECORD_FORMATS = {TELEMETRY_BAR: BAR_RECORD, TELEMETRY_HISTORY: HISTORY_POINT, TELEMETRY_DEPTH: DEPTH_RECORD}
+
+#! UPDATE THESE TO CHANGE HOW MUCH OF THE DEPTH HEATMAP IS SHOWN
+DEPTH_COLUMNS = 600         # Most recent book states drawn
+DEPTH_MAX_ROWS = 200        # Price levels drawn, centred on the latest mid
+
+# Shared memory ring layout -- must match telemetryRingHeader / telemetryRingSlot in telemetry.h
+RING_PATH = '/dev/shm/trading_telemetry'
+RING_MAGIC = 0x474E5254
+RING_HEADER = struct.Struct('<IHHIIQ')  # magic, version, reserved, slot count, slot bytes, run ID
+RING_HEADER_BYTES = 128
+RING_WRITE_SEQUENCE = 64                # Offset of the write sequence
+SLOT_HEADER = struct.Struct('<QI')      # sequence (packet number + 1, 0 while being written), packet length
+SLOT_HEADER_BYTES = 16
+
+
+# Reads packets out of the shared memory ring the C program publishes into
+class ShmRingReader:
+    def __init__(self, path=RING_PATH):
+        self.path = path
+        self.mapping = None
+        self.run_id = None
+        self.slot_count = 0
+        self.slot_bytes = 0
+        self.next_sequence = 0
+
+    # Map the ring -- it is recreated by each run, so this is done again whenever the run ID changes
+    def attach(self):
+        if self.mapping is not None:
+            self.mapping.close()
+            self.mapping = None
+        try:
+            with open(self.path, 'rb') as f:
+                self.mapping = mmap.mmap(f.fileno(), 0, access=mmap.ACCESS_READ)
+        except (OSError, ValueError):
+            return False
+        if len(self.mapping) < RING_HEADER_BYTES:
+            self.mapping.close()
+            self.mapping = None
+            return False
+        return True
+
+    # Copy out every packet published since the last poll -- returns the packets and how many were lost
+    def poll(self):
+        if self.mapping is None and not self.attach():
+            return [], 0
+        magic, version, _, slot_count, slot_bytes, run_id = RING_HEADER.unpack_from(self.mapping)
+        if magic != RING_MAGIC or version != TELEMETRY_VERSION:
+            return [], 0
+        if run_id != self.run_id:
+            # A new run -- remap in case the ring changed size and start from the oldest packet still held
+            if not self.attach():
+                return [], 0
+            self.run_id = run_id
+            self.slot_count = slot_count
+            self.slot_bytes = slot_bytes
+            write_sequence, = struct.unpack_from('<Q', self.mapping, RING_WRITE_SEQUENCE)
+            self.next_sequence = max(0, write_sequence - slot_count)
+            if len(self.mapping) < RING_HEADER_BYTES + slot_count * slot_bytes:
+                return [], 0
+
+        write_sequence, = struct.unpack_from('<Q', self.mapping, RING_WRITE_SEQUENCE)
+        lost = 0
+        # The writer has lapped us -- everything older than one ring's worth is gone
+        if write_sequence - self.next_sequence > self.slot_count:
+            lost += write_sequence - self.slot_count - self.next_sequence
+            self.next_sequence = write_sequence - self.slot_count
+
+        packets = []
+        while self.next_sequence < write_sequence:
+            offset = RING_HEADER_BYTES + (self.next_sequence % self.slot_count) * self.slot_bytes
+            sequence, length = SLOT_HEADER.unpack_from(self.mapping, offset)
+            if sequence == self.next_sequence + 1 and length <= self.slot_bytes - SLOT_HEADER_BYTES:
+                data = self.mapping[offset + SLOT_HEADER_BYTES:offset + SLOT_HEADER_BYTES + length]
+                # Only keep the copy if the slot wasn't reused while we were reading it
+                sequence_after, = struct.unpack_from('<Q', self.mapping, offset)
+                if sequence_after == sequence:
+                    packets.append(data)
+                else:
+                    lost += 1
+            else:
+                # Overwritten by a newer packet before we got to it
+                lost += 1
+            self.next_sequence += 1
+        return packets, lost
 
 
 class RealTimeGrapher:
-    def __init__(self):
+    def __init__(self, use_shm=False, show_depth=False):
+        
+        # Data storage -- the C program sends bars and an LTTB-reduced long history, so nothing is downsampled here.
+        # Bars newer than the last complete history are drawn after it
+        self.bars = deque(maxlen=20000)
+        self.history_price = ([], [], [])       # line, bid, ask
+        self.history_value = ([], [])           # line, portfolio value
+        self.pending_history = {}               # generation -> points received so far
         
-        # Data storage - Add a max_length to the deque's to limit data points plotted
-        self.bid_prices = deque()
-        self.ask_prices = deque()
-        self.portfolio_values = deque()
-        self.line_numbers = deque()
+        # Depth book rebuilt from changed levels -- only trusted from a full snapshot until packets go missing
+        self.show_depth = show_depth
+        self.depth_book = ({}, {})              # bids, asks: price in ticks -> volume
+        self.depth_synced = False
+        self.depth_line = None
+        self.depth_columns = deque(maxlen=DEPTH_COLUMNS)    # (line, bids, asks) after each update
         
         # Thread synchronization
         self.data_lock = Lock()
         self.last_update_time = time.time()
         
-        # Socket setup
-        self.sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
-        try:
-            self.sock.bind(('127.0.0.1', 8888))
-            print("Successfully bound to port 8888")
-        except Exception as e:
-            print(f"Failed to bind to port 8888: {e}")
-            return
-            
-        self.sock.settimeout(0.1)
+        # Read from the shared memory ring, or fall back to the UDP socket
+        self.sock = None
+        self.ring = ShmRingReader() if use_shm else None
+        if self.ring is not None:
+            print(f"Reading telemetry from shared memory ring {RING_PATH}")
+        else:
+            # Socket setup
+            self.sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+            # History resends arrive as bursts of datagrams, so give the kernel room to hold them while we're busy drawing
+            self.sock.setsockopt(socket.SOL_SOCKET, socket.SO_RCVBUF, 8 * 1024 * 1024)
+            try:
+                self.sock.bind(('127.0.0.1', 8888))
+                print("Successfully bound to port 8888")
+            except Exception as e:
+                print(f"Failed to bind to port 8888: {e}")
+                return
+                
+            self.sock.settimeout(0.1)
         
         # Plot setup
-        self.fig, (self.ax1, self.ax2) = plt.subplots(2, 1, figsize=(12, 8))
+        if show_depth:
+            self.fig, (self.ax1, self.ax2, self.ax3) = plt.subplots(3, 1, figsize=(12, 11))
+        else:
+            self.fig, (self.ax1, self.ax2) = plt.subplots(2, 1, figsize=(12, 8))
         self.fig.suptitle('Real-Time Trading Data - Waiting for data...')
         
-        # Price lines
+        # Price lines -- the shaded band is each recent bar's bid low to ask high
         self.line_bid, = self.ax1.plot([], [], 'g-', linewidth=1, label='Bid Price')
         self.line_ask, = self.ax1.plot([], [], 'r-', linewidth=1, label='Ask Price')
+        self.bar_range = None
         
         #! UPDATE THESE HORIZONTAL LINES' VALUES IF USING SUPPORT/RESISTANCE STRATEGY
         # Static support/resistance lines (drawn once, not updated) - Used to show support/resistance levels
@@ -75,15 +202,140 @@ class RealTimeGrapher:
         self.ax2.legend()
         self.ax2.grid(True, alpha=0.3)
         
+        # Depth heatmap -- bid volume drawn positive (green), ask volume negative (red)
+        self.depth_image = None
+        if show_depth:
+            self.ax3.set_title('Order Book Depth - Waiting for a snapshot...')
+            self.ax3.set_xlabel('Tick')
+            self.ax3.set_ylabel('Price')
+        
         # Start data receiver thread
         self.running = True
         self.data_received_count = 0
-        self.data_thread = threading.Thread(target=self.receive_data, daemon=True)
+        self.packets_lost = 0
+        self.next_sequence = None
+        receiver = self.receive_shm if self.ring is not None else self.receive_data
+        self.data_thread = threading.Thread(target=receiver, daemon=True)
         self.data_thread.start()
         
         print("Python grapher started - waiting for C program data...")
 
 
+    # Unpack one telemetry packet into its header fields and records -- None if it isn't one of ours
+    def decode_packet(self, data):
+        if len(data) < HEADER.size:
+            return None
+        magic, version, kind, sequence, count, record_size = HEADER.unpack_from(data)
+        if magic != TELEMETRY_MAGIC or version != TELEMETRY_VERSION:
+            return None
+        body = data[HEADER.size:HEADER.size + count * record_size]
+        record_format = RECORD_FORMATS.get(kind)
+        if record_format is None or record_size != record_format.size or len(body) != count * record_size:
+            return None
+        return sequence, kind, list(record_format.iter_unpack(body))
+
+
+    # Add decoded records to the plotted data -- called with data_lock held
+    def add_records(self, kind, records):
+        if kind == TELEMETRY_BAR:
+            self.bars.extend(records)
+        elif kind == TELEMETRY_DEPTH:
+            self.apply_depth(records)
+        else:
+            for point in records:
+                generation, total = point[3], point[5]
+                points = self.pending_history.setdefault(generation, [])
+                points.append(point)
+                if len(points) == total:
+                    self.install_history(generation)
+        
+        self.data_received_count += 1
+        self.last_update_time = time.time()
+
+
+    # Apply changed depth levels -- the book as it stood after each line is kept for the heatmap
+    def apply_depth(self, records):
+        for line, price, volume, side, flags, _ in records:
+            if line != self.depth_line:
+                self.commit_depth_column()
+            self.depth_line = line
+            
+            if flags & DEPTH_SNAPSHOT_START:
+                self.depth_book[0].clear()
+                self.depth_book[1].clear()
+                self.depth_synced = True
+            # Changes after lost packets can't be applied to a book we no longer match -- wait for the start of the
+            # next snapshot (the rest of one whose start was lost isn't enough)
+            if not self.depth_synced:
+                continue
+            
+            book = self.depth_book[side]
+            if volume == 0:
+                book.pop(price, None)
+            else:
+                book[price] = volume
+        # The last line's changes may continue in the next packet, so its column is replaced until the line moves on
+        self.commit_depth_column()
+
+
+    # Keep the book as it stands for the current line as the newest heatmap column
+    def commit_depth_column(self):
+        if self.depth_line is None or not self.depth_synced:
+            return
+        column = (self.depth_line, dict(self.depth_book[0]), dict(self.depth_book[1]))
+        if self.depth_columns and self.depth_columns[-1][0] == self.depth_line:
+            self.depth_columns[-1] = column
+        else:
+            self.depth_columns.append(column)
+
+
+    # Lost packets may have held depth changes, so the rebuilt book can't be trusted until the next snapshot
+    def note_lost_packets(self, lost):
+        if lost > 0:
+            self.packets_lost += lost
+            self.depth_synced = False
+            # The line being built may have carried on in a lost packet
+            if self.depth_columns and self.depth_columns[-1][0] == self.depth_line:
+                self.depth_columns.pop()
+
+
+    # Replace the long history with a generation that has fully arrived
+    def install_history(self, generation):
+        points = self.pending_history.pop(generation)
+        # Older generations still arriving are out of date now (and ones lost in transit never finish)
+        for old in [g for g in self.pending_history if g < generation]:
+            del self.pending_history[old]
+        
+        price = [p for p in points if p[4] == HISTORY_PRICE]
+        value = [p for p in points if p[4] == HISTORY_VALUE]
+        self.history_price = ([p[0] for p in price], [p[1] for p in price], [p[2] for p in price])
+        self.history_value = ([p[0] for p in value], [p[1] for p in value])
+        
+        # Bars the history already covers don't need drawing on their own
+        covered = max(self.history_price[0][-1] if price else 0, self.history_value[0][-1] if value else 0)
+        while self.bars and self.bars[0][1] <= covered:
+            self.bars.popleft()
+
+
+    # Poll the shared memory ring for new packets -- overruns show up as lost packets
+    def receive_shm(self):
+        while self.running:
+            packets, lost = self.ring.poll()
+            if not packets and not lost:
+                if time.time() - self.last_update_time > 10:  # 10 seconds
+                    print("No data received for 10 seconds...")
+                    self.last_update_time = time.time()
+                time.sleep(0.01)
+                continue
+            
+            decoded = [self.decode_packet(data) for data in packets]
+            with self.data_lock:
+                self.note_lost_packets(lost)
+                for packet in decoded:
+                    if packet is not None:
+                        self.add_records(packet[1], packet[2])
+
+
     # Control the data coming into the script and assign to lists
     def receive_data(self):
         # Variables to check if values are missing
@@ -92,41 +344,24 @@ class RealTimeGrapher:
         
         while self.running:
             try:
-                data, addr = self.sock.recvfrom(1024)
-                data_str = data.decode('utf-8').strip()
+                data, addr = self.sock.recvfrom(65536)
                 
                 # Reset error counter on successful receive
                 consecutive_errors = 0
                 
-                # Parse CSV format: line,bid,ask,portfolio
-                parts = data_str.split(',')
-                if len(parts) == 4:
-                    try:
-                        line_num = int(parts[0])
-                        bid = float(parts[1])
-                        ask = float(parts[2])
-                        portfolio = float(parts[3])
-                    except ValueError as e:
-                        print(f"Parsing error: {e}")
-                        continue  # skip this packet
-                    
-                    # Process each message with thread safety
-                    with self.data_lock:
-                        try:
-                            # Add data atomically
-                            self.line_numbers.append(line_num)
-                            self.bid_prices.append(bid)
-                            self.ask_prices.append(ask)
-                            self.portfolio_values.append(portfolio)
-                            
-                            self.data_received_count += 1
-                            self.last_update_time = time.time()
-                            
-                            # Debug output
-                            #print(f"Data packets received: {self.data_received_count}")
-                            
-                        except (KeyError, ValueError, TypeError) as e:
-                            print(f"Data processing error: {e}")
+                packet = self.decode_packet(data)
+                if packet is None:
+                    print(f"Ignoring unrecognised packet of {len(data)} bytes")
+                    continue
+                sequence, kind, records = packet
+                
+                # Process each packet with thread safety
+                with self.data_lock:
+                    # A jump in sequence means UDP dropped packets on the way
+                    if self.next_sequence is not None and sequence > self.next_sequence:
+                        self.note_lost_packets(sequence - self.next_sequence)
+                    self.next_sequence = sequence + 1
+                    self.add_records(kind, records)
                 
             except socket.timeout:
                 # Check if we haven't received data for too long
@@ -145,56 +380,93 @@ class RealTimeGrapher:
                 # Pause a little before retrying
                 time.sleep(0.1)  
 
-    # Downsample data so we aren't plotting too many in large files
-    def downsample(self, x, y, max_points):
-        n = len(y)
-        if n <= max_points or max_points <= 0:
-            return x, y
-        step = n // max_points
-        x_ds = x[::step]
-        y_ds = y[::step]
-        return x_ds, y_ds
+    # Redraw the depth heatmap from the most recent book states
+    def animate_depth(self):
+        with self.data_lock:
+            columns = list(self.depth_columns)
+            synced = self.depth_synced
+        if not columns:
+            return
+        
+        # Rows cover the prices seen, capped around the latest mid so one stray level can't squash the rest
+        prices = [price for _, bids, asks in columns for price in list(bids) + list(asks)]
+        if not prices:
+            return
+        low, high = min(prices), max(prices)
+        if high - low + 1 > DEPTH_MAX_ROWS:
+            _, bids, asks = columns[-1]
+            touch = list(bids) + list(asks)
+            mid = (min(touch) + max(touch)) // 2 if touch else (low + high) // 2
+            low, high = mid - DEPTH_MAX_ROWS // 2, mid + DEPTH_MAX_ROWS // 2 - 1
+        
+        grid = np.zeros((high - low + 1, len(columns)))
+        for column, (_, bids, asks) in enumerate(columns):
+            for price, volume in bids.items():
+                if low <= price <= high:
+                    grid[price - low, column] = volume
+            for price, volume in asks.items():
+                if low <= price <= high:
+                    grid[price - low, column] = -volume
+        
+        limit = max(np.abs(grid).max(), 1e-9)
+        extent = (columns[0][0], columns[-1][0], (low - 0.5) * DEPTH_PRICE_TICK, (high + 0.5) * DEPTH_PRICE_TICK)
+        if self.depth_image is None:
+            self.depth_image = self.ax3.imshow(grid, aspect='auto', origin='lower', extent=extent, cmap='RdYlGn',
+                                               interpolation='nearest', vmin=-limit, vmax=limit)
+        else:
+            self.depth_image.set_data(grid)
+            self.depth_image.set_extent(extent)
+            self.depth_image.set_clim(-limit, limit)
+        state = 'in sync' if synced else 'waiting for a snapshot after lost packets'
+        self.ax3.set_title(f'Order Book Depth - last {len(columns)} updates ({state})')
 
 
     # Update data drawn on lines in the graph
     def animate(self, frame):
         try:
+            if self.show_depth:
+                self.animate_depth()
+            
             # Thread-safe data access
             with self.data_lock:
                 # Make local copies and ensure consistency
                 data_count = self.data_received_count
+                packets_lost = self.packets_lost
+                bars = list(self.bars)
+                history_lines, history_bid, history_ask = self.history_price
+                history_value_lines, history_values = self.history_value
                 
-                # Ensure all arrays have same length
-                min_length = min(len(self.line_numbers), len(self.bid_prices), 
-                           len(self.ask_prices), len(self.portfolio_values))
-                
-                if min_length == 0:
+                if not bars and not history_lines:
                     return self.line_bid, self.line_ask, self.line_pv
-                
-                # Create synchronized data arrays
-                line_numbers_safe = list(self.line_numbers)[:min_length]
-                bid_prices_safe = list(self.bid_prices)[:min_length]
-                ask_prices_safe = list(self.ask_prices)[:min_length]
-                portfolio_values_safe = list(self.portfolio_values)[:min_length]
-
-            # Downsample the data - THIS CAN BE ALTERED TO BE MORE/LESS PRECISE    
-            x_bid, y_bid = self.downsample(line_numbers_safe, bid_prices_safe, 5000)
-            x_ask, y_ask = self.downsample(line_numbers_safe, ask_prices_safe, 5000)
-            x_pv, y_pv = self.downsample(line_numbers_safe, portfolio_values_safe, 2000)
+            
+            # Long history first, then the bars that arrived since it was sent
+            bar_lines = [bar[1] for bar in bars]
+            x_price = history_lines + bar_lines
+            y_bid = history_bid + [bar[7] for bar in bars]
+            y_ask = history_ask + [bar[11] for bar in bars]
+            x_pv = history_value_lines + bar_lines
+            y_pv = history_values + [bar[12] for bar in bars]
             
             # Updating line data
-            self.line_bid.set_data(x_bid, y_bid)
-            self.line_ask.set_data(x_ask, y_ask)
-            self.line_pv.set_data(x_pv, y_pv)    
+            self.line_bid.set_data(x_price, y_bid)
+            self.line_ask.set_data(x_price, y_ask)
+            self.line_pv.set_data(x_pv, y_pv)
+            if self.bar_range is not None:
+                self.bar_range.remove()
+                self.bar_range = None
+            if bars:
+                self.bar_range = self.ax1.fill_between(bar_lines, [bar[6] for bar in bars], [bar[9] for bar in bars],
+                                                       color='grey', alpha=0.3, linewidth=0)
         
             # Setting axes limits -- We want to show change from start (0)
-            self.ax1.set_xlim(0, max(line_numbers_safe))
-            self.ax2.set_xlim(0, max(line_numbers_safe))
+            self.ax1.set_xlim(0, max(x_price))
+            self.ax2.set_xlim(0, max(x_pv))
             
             # Update title to contain up-to-date info
-            self.fig.suptitle(f'Real-Time Trading Data - Received {data_count} packets')
-            self.ax1.set_title(f'Bid/Ask Prices -- Bid: {bid_prices_safe[-1]} | Ask: {ask_prices_safe[-1]}')
-            self.ax2.set_title(f'Portfolio Value (in 100,000s) - Current Value: {portfolio_values_safe[-1]}')
+            self.fig.suptitle(f'Real-Time Trading Data - Received {data_count} packets ({packets_lost} lost) - '
+                              f'{len(history_lines)} history points + {len(bars)} bars')
+            self.ax1.set_title(f'Bid/Ask Prices -- Bid: {y_bid[-1]} | Ask: {y_ask[-1]}')
+            self.ax2.set_title(f'Portfolio Value (in 100,000s) - Current Value: {y_pv[-1]}')
             
             return self.line_bid, self.line_ask, self.line_pv
         
@@ -215,10 +487,12 @@ class RealTimeGrapher:
             print("Graph window closed")
         finally:
             self.running = False
-            self.sock.close()
+            if self.sock is not None:
+                self.sock.close()
 
 
 if __name__ == "__main__":
-    # Create graph making object and run it 
-    grapher = RealTimeGrapher()
+    # Create graph making object and run it -- pass --shm when main.c has TELEMETRY_SHM_ENABLED set
+    # and --depth when it has DEPTH_STREAM_ENABLED set
+    grapher = RealTimeGrapher(use_shm='--shm' in sys.argv[1:], show_depth='--depth' in sys.argv[1:])
     grapher.run()
\ No newline at end of file
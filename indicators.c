@@ -0,0 +1,269 @@
+#include "indicators.h"
+#include <math.h>
+
+
+//! Rolling Window -- ring buffer shared by every windowed indicator
+// Create a window holding up to capacity samples, optionally limited to the last spanNs of time
+void window_init(rollingWindow *window, int capacity, long long spanNs) {
+    if (capacity < 1) {
+        capacity = 1;
+    }
+    window->samples = malloc(sizeof(windowSample) * capacity);
+    if (!window->samples) {
+        printf("Error Allocating Memory!\n");
+        exit(-1);
+    }
+    window->capacity = capacity;
+    window->head = 0;
+    window->count = 0;
+    window->spanNs = spanNs;
+    window->seq = 0;
+}
+
+
+// Free a window's samples
+void window_free(rollingWindow *window) {
+    free(window->samples);
+    window->samples = NULL;
+    window->count = 0;
+}
+
+
+// Oldest sample still in the window
+static windowSample *window_front(rollingWindow *window) {
+    return &window->samples[window->head];
+}
+
+
+// Newest sample in the window
+static windowSample *window_back(rollingWindow *window) {
+    int index = window->head + window->count - 1;
+    return &window->samples[(index >= window->capacity) ? index - window->capacity : index];
+}
+
+
+// Add a sample at the newest end -- caller makes sure there is room
+static void window_push(rollingWindow *window, windowSample sample) {
+    int index = window->head + window->count;
+    window->samples[(index >= window->capacity) ? index - window->capacity : index] = sample;
+    window->count++;
+}
+
+
+// Remove the oldest sample
+static windowSample window_pop_front(rollingWindow *window) {
+    windowSample oldest = window->samples[window->head];
+    window->head = (window->head + 1 == window->capacity) ? 0 : window->head + 1;
+    window->count--;
+    return oldest;
+}
+
+
+// Check if the oldest sample has to leave before a sample at time now can be added
+static bool window_expired(rollingWindow *window, long long now) {
+    if (window->count == 0) {
+        return false;
+    }
+    if (window->count == window->capacity) {
+        return true;
+    }
+    return window->spanNs > 0 && window_front(window)->time <= now - window->spanNs;
+}
+
+
+//! Simple Moving Average
+// ticks is the window length, or the most samples a time based (spanNs > 0) window can hold
+void sma_init(movingAverage *ma, int ticks, long long spanNs) {
+    window_init(&ma->window, ticks, spanNs);
+    ma->sum = 0;
+}
+
+
+// Add a value and return the average over the window
+double sma_update(movingAverage *ma, double value, long long time) {
+    while (window_expired(&ma->window, time)) {
+        ma->sum -= window_pop_front(&ma->window).value;
+    }
+    window_push(&ma->window, (windowSample){value, 0, time, ma->window.seq++});
+    ma->sum += value;
+    return ma->sum / ma->window.count;
+}
+
+
+//! Exponential Moving Average
+// Uses the usual 2/(N+1) smoothing for an N period EMA
+void ema_init(expMovingAverage *ema, int periods) {
+    ema->alpha = 2.0 / (periods + 1.0);
+    ema->value = 0;
+    ema->primed = false;
+}
+
+
+// Add a value and return the new EMA
+double ema_update(expMovingAverage *ema, double value) {
+    if (!ema->primed) {
+        ema->value = value;
+        ema->primed = true;
+    } else {
+        ema->value += ema->alpha * (value - ema->value);
+    }
+    return ema->value;
+}
+
+
+//! Rolling Variance / Volatility
+// Window arguments work the same as sma_init
+void variance_init(rollingVariance *var, int ticks, long long spanNs) {
+    window_init(&var->window, ticks, spanNs);
+    var->mean = 0;
+    var->m2 = 0;
+    var->lastPrice = 0;
+}
+
+
+// Add a value and return the sample variance over the window
+double variance_update(rollingVariance *var, double value, long long time) {
+    // Welford removal of samples leaving the window
+    while (window_expired(&var->window, time)) {
+        double old = window_pop_front(&var->window).value;
+        int n = var->window.count;
+        if (n == 0) {
+            var->mean = 0;
+            var->m2 = 0;
+        } else {
+            double delta = old - var->mean;
+            var->mean -= delta / n;
+            var->m2 -= delta * (old - var->mean);
+        }
+    }
+    // Welford addition of the new sample
+    window_push(&var->window, (windowSample){value, 0, time, var->window.seq++});
+    double delta = value - var->mean;
+    var->mean += delta / var->window.count;
+    var->m2 += delta * (value - var->mean);
+
+    // Rounding can push m2 very slightly negative
+    if (var->m2 < 0) {
+        var->m2 = 0;
+    }
+    return (var->window.count > 1) ? var->m2 / (var->window.count - 1) : 0;
+}
+
+
+// Feed prices and return the rolling standard deviation of their log returns
+double volatility_update(rollingVariance *var, double price, long long time) {
+    if (var->lastPrice > 0 && price > 0) {
+        variance_update(var, log(price / var->lastPrice), time);
+    }
+    var->lastPrice = price;
+    return variance_stddev(var);
+}
+
+
+// Standard deviation of the samples currently in the window
+double variance_stddev(const rollingVariance *var) {
+    return (var->window.count > 1) ? sqrt(var->m2 / (var->window.count - 1)) : 0;
+}
+
+
+//! Rolling VWAP
+// Window arguments work the same as sma_init
+void vwap_init(rollingVWAP *vwap, int ticks, long long spanNs) {
+    window_init(&vwap->window, ticks, spanNs);
+    vwap->sumPriceVolume = 0;
+    vwap->sumVolume = 0;
+}
+
+
+// Add a price/volume pair and return the VWAP over the window
+double vwap_update(rollingVWAP *vwap, double price, double volume, long long time) {
+    while (window_expired(&vwap->window, time)) {
+        windowSample old = window_pop_front(&vwap->window);
+        vwap->sumPriceVolume -= old.value * old.weight;
+        vwap->sumVolume -= old.weight;
+    }
+    window_push(&vwap->window, (windowSample){price, volume, time, vwap->window.seq++});
+    vwap->sumPriceVolume += price * volume;
+    vwap->sumVolume += volume;
+    return (vwap->sumVolume > 0) ? vwap->sumPriceVolume / vwap->sumVolume : price;
+}
+
+
+//! Rolling Min/Max
+// Tick based when spanNs is 0, otherwise time based holding at most maxSamples candidates
+void extreme_init(rollingExtreme *ext, bool isMax, int ticks, long long spanNs, int maxSamples) {
+    window_init(&ext->deque, (spanNs > 0) ? maxSamples : ticks, spanNs);
+    ext->windowTicks = ticks;
+    ext->isMax = isMax;
+}
+
+
+// Add a value and return the min/max over the window
+double extreme_update(rollingExtreme *ext, double value, long long time) {
+    rollingWindow *deque = &ext->deque;
+    long long seq = deque->seq++;
+
+    // Drop candidates that have left the window
+    while (deque->count > 0) {
+        windowSample *oldest = window_front(deque);
+        bool expired = (deque->spanNs > 0) ? oldest->time <= time - deque->spanNs : oldest->seq <= seq - ext->windowTicks;
+        if (!expired) {
+            break;
+        }
+        window_pop_front(deque);
+    }
+    // Drop candidates the new value beats -- they can never be the extreme again
+    while (deque->count > 0) {
+        double newest = window_back(deque)->value;
+        if (ext->isMax ? newest > value : newest < value) {
+            break;
+        }
+        deque->count--;
+    }
+    // A time based window may be holding more candidates than it has room for
+    if (deque->count == deque->capacity) {
+        window_pop_front(deque);
+    }
+    window_push(deque, (windowSample){value, 0, time, seq});
+    return window_front(deque)->value;
+}
+
+
+// Current min/max without adding a value
+double extreme_value(const rollingExtreme *ext) {
+    return (ext->deque.count > 0) ? ext->deque.samples[ext->deque.head].value : 0;
+}
+
+
+//! Market Indicators -- the standard set updated once per tick
+// All windows share one length -- ticks, or time if spanNs > 0 (ticks then bounds the samples kept)
+void market_indicators_init(marketIndicators *ind, int ticks, long long spanNs) {
+    sma_init(&ind->midAverage, ticks, spanNs);
+    ema_init(&ind->midEma, ticks);
+    variance_init(&ind->volatility, ticks, spanNs);
+    vwap_init(&ind->vwap, ticks, spanNs);
+    extreme_init(&ind->bidLow, false, ticks, spanNs, ticks);
+    extreme_init(&ind->askHigh, true, ticks, spanNs, ticks);
+}
+
+
+// Update every indicator from a single tick
+void market_indicators_update(marketIndicators *ind, const orderLine *line, long long time) {
+    double mid = (line->bidPrice + line->askPrice) / 2.0;
+    sma_update(&ind->midAverage, mid, time);
+    ema_update(&ind->midEma, mid);
+    volatility_update(&ind->volatility, mid, time);
+    vwap_update(&ind->vwap, mid, line->bidVolume + line->askVolume, time);
+    extreme_update(&ind->bidLow, line->bidPrice, time);
+    extreme_update(&ind->askHigh, line->askPrice, time);
+}
+
+
+// Free every indicator's window
+void market_indicators_free(marketIndicators *ind) {
+    window_free(&ind->midAverage.window);
+    window_free(&ind->volatility.window);
+    window_free(&ind->vwap.window);
+    window_free(&ind->bidLow.deque);
+    window_free(&ind->askHigh.deque);
+}
\ No newline at end of file
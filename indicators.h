@@ -0,0 +1,96 @@
+#ifndef INDICATORS_H
+#define INDICATORS_H
+
+// Standard includes
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+
+// Including other project headers
+#include "data_read.h"
+
+// One sample held in a rolling window
+typedef struct {
+    double value;
+    double weight;          // Volume for VWAP, unused otherwise
+    long long time;         // Tick time in ns
+    long long seq;          // Tick number the sample was added on
+} windowSample;
+
+// Ring buffer of the samples inside a window -- tick based (last N) or time based (last spanNs)
+typedef struct {
+    windowSample *samples;
+    int capacity;
+    int head;               // Index of the oldest sample
+    int count;
+    long long spanNs;       // 0 for tick based windows
+    long long seq;
+} rollingWindow;
+
+// Simple moving average
+typedef struct {
+    rollingWindow window;
+    double sum;
+} movingAverage;
+
+// Exponential moving average
+typedef struct {
+    double alpha;
+    double value;
+    bool primed;
+} expMovingAverage;
+
+// Rolling variance using Welford's add/remove updates
+typedef struct {
+    rollingWindow window;
+    double mean;
+    double m2;
+    double lastPrice;       // Used when fed prices to measure volatility of log returns
+} rollingVariance;
+
+// Rolling volume weighted average price
+typedef struct {
+    rollingWindow window;
+    double sumPriceVolume;
+    double sumVolume;
+} rollingVWAP;
+
+// Rolling min or max using a monotonic deque -- O(1) amortised per update
+typedef struct {
+    rollingWindow deque;    // Samples in order of age, values monotonic from front to back
+    int windowTicks;        // Tick based window length (ignored for time based windows)
+    bool isMax;
+} rollingExtreme;
+
+// Standard set of indicators kept up to date from each tick
+typedef struct {
+    movingAverage midAverage;
+    expMovingAverage midEma;
+    rollingVariance volatility;
+    rollingVWAP vwap;
+    rollingExtreme bidLow;
+    rollingExtreme askHigh;
+} marketIndicators;
+
+// Function declarations
+void window_init(rollingWindow *window, int capacity, long long spanNs);
+void window_free(rollingWindow *window);
+void sma_init(movingAverage *ma, int ticks, long long spanNs);
+double sma_update(movingAverage *ma, double value, long long time);
+void ema_init(expMovingAverage *ema, int periods);
+double ema_update(expMovingAverage *ema, double value);
+void variance_init(rollingVariance *var, int ticks, long long spanNs);
+double variance_update(rollingVariance *var, double value, long long time);
+double volatility_update(rollingVariance *var, double price, long long time);
+double variance_stddev(const rollingVariance *var);
+void vwap_init(rollingVWAP *vwap, int ticks, long long spanNs);
+double vwap_update(rollingVWAP *vwap, double price, double volume, long long time);
+void extreme_init(rollingExtreme *ext, bool isMax, int ticks, long long spanNs, int maxSamples);
+double extreme_update(rollingExtreme *ext, double value, long long time);
+double extreme_value(const rollingExtreme *ext);
+void market_indicators_init(marketIndicators *ind, int ticks, long long spanNs);
+void market_indicators_update(marketIndicators *ind, const orderLine *line, long long time);
+void market_indicators_free(marketIndicators *ind);
+
+#endif
\ No newline at end of file
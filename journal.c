@@ -0,0 +1,144 @@
+#include "journal.h"
+#include "alloc_track.h"
+#include <math.h>
+
+
+//! Fill Journal -- fills are buffered and written to disk in large blocks
+// Open (truncate) a journal file, returning false if it can't be created
+bool journal_open(fillJournal *journal, const char *filename) {
+    journal->file = fopen(filename, "wb");
+    journal->buffer = tracked_malloc(AllocTelemetry, JOURNAL_BUFFER_SIZE);
+    journal->used = 0;
+    journal->recordsWritten = 0;
+    if (!journal->file || !journal->buffer) {
+        perror("Error opening fill journal");
+        if (journal->file) {
+            fclose(journal->file);
+        }
+        tracked_free(AllocTelemetry, journal->buffer, JOURNAL_BUFFER_SIZE);
+        journal->file = NULL;
+        journal->buffer = NULL;
+        return false;
+    }
+    return true;
+}
+
+
+// Append a fill to the journal
+void journal_write_fill(fillJournal *journal, const fillRecord *record) {
+    if (journal->file == NULL) {
+        return;
+    }
+    if (journal->used + sizeof(fillRecord) > JOURNAL_BUFFER_SIZE) {
+        journal_flush(journal);
+    }
+    memcpy(journal->buffer + journal->used, record, sizeof(fillRecord));
+    journal->used += sizeof(fillRecord);
+    journal->recordsWritten++;
+}
+
+
+// Write out whatever is buffered
+void journal_flush(fillJournal *journal) {
+    if (journal->file == NULL || journal->used == 0) {
+        return;
+    }
+    fwrite(journal->buffer, 1, journal->used, journal->file);
+    journal->used = 0;
+}
+
+
+// Flush and close the journal
+void journal_close(fillJournal *journal) {
+    if (journal->file == NULL) {
+        return;
+    }
+    journal_flush(journal);
+    fclose(journal->file);
+    tracked_free(AllocTelemetry, journal->buffer, JOURNAL_BUFFER_SIZE);
+    journal->file = NULL;
+    journal->buffer = NULL;
+}
+
+
+//! P&L Analytics
+// Begin tracking from an account's balances -- any starting base is treated as bought at the mark
+void analytics_start(pnlAnalytics *stats, double baseBalance, double quoteBalance, double markPrice) {
+    memset(stats, 0, sizeof(pnlAnalytics));
+    stats->started = true;
+    stats->position = baseBalance;
+    stats->averageCost = markPrice;
+    stats->startEquity = baseBalance * markPrice + quoteBalance;
+    stats->equity = stats->startEquity;
+    stats->peakEquity = stats->startEquity;
+}
+
+
+// Fold a fill into the position, average cost and realised P&L
+void analytics_on_fill(pnlAnalytics *stats, bool isBuy, double price, double volume) {
+    double signedVolume = isBuy ? volume : -volume;
+    stats->trades++;
+
+    if (stats->position == 0 || (stats->position > 0) == isBuy) {
+        // Adding to (or opening) a position -- blend the average cost
+        double size = fabs(stats->position);
+        stats->averageCost = (stats->averageCost * size + price * volume) / (size + volume);
+        stats->position += signedVolume;
+        return;
+    }
+    // Reducing a position -- realise P&L on the part that closes
+    double closing = (volume < fabs(stats->position)) ? volume : fabs(stats->position);
+    double tradePnL = closing * (price - stats->averageCost) * ((stats->position > 0) ? 1.0 : -1.0);
+    stats->realisedPnL += tradePnL;
+    stats->closingTrades++;
+    if (tradePnL > 0) {
+        stats->winningTrades++;
+    }
+    stats->position += signedVolume;
+
+    // Flipped through flat -- the remainder opens a new position at this price
+    if (volume > closing) {
+        stats->averageCost = price;
+    } else if (fabs(stats->position) < 1e-12) {
+        stats->position = 0;
+        stats->averageCost = 0;
+    }
+}
+
+
+// Mark the position to market and update drawdown and return statistics
+void analytics_on_tick(pnlAnalytics *stats, double markPrice) {
+    stats->unrealisedPnL = stats->position * (markPrice - stats->averageCost);
+    double equity = stats->startEquity + stats->realisedPnL + stats->unrealisedPnL;
+
+    // Welford update of per-tick returns for the running Sharpe
+    if (stats->equity != 0) {
+        double change = (equity - stats->equity) / stats->equity;
+        stats->returnCount++;
+        double delta = change - stats->returnMean;
+        stats->returnMean += delta / stats->returnCount;
+        stats->returnM2 += delta * (change - stats->returnMean);
+    }
+    stats->equity = equity;
+
+    if (equity > stats->peakEquity) {
+        stats->peakEquity = equity;
+    } else if (stats->peakEquity - equity > stats->maxDrawdown) {
+        stats->maxDrawdown = stats->peakEquity - equity;
+    }
+}
+
+
+// Fraction of closing trades that made money
+double analytics_win_rate(const pnlAnalytics *stats) {
+    return (stats->closingTrades > 0) ? (double) stats->winningTrades / stats->closingTrades : 0;
+}
+
+
+// Mean over standard deviation of per-tick equity returns (not annualised)
+double analytics_sharpe(const pnlAnalytics *stats) {
+    if (stats->returnCount < 2 || stats->returnM2 <= 0) {
+        return 0;
+    }
+    return stats->returnMean / sqrt(stats->returnM2 / (stats->returnCount - 1));
+}
\ No newline at end of file
@@ -0,0 +1,65 @@
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+// Standard includes
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+// Define how much the journal buffers before writing to disk
+#define JOURNAL_BUFFER_SIZE (64 * 1024)
+
+// One fill as stored in the binary journal -- 48 bytes, little-endian, no padding
+typedef struct {
+    int64_t timestamp;          // Tick time in ns since epoch
+    double price;
+    double volume;
+    double baseBalance;         // Account balances after the fill
+    double quoteBalance;
+    int32_t orderID;
+    uint8_t side;               // 0 = Bid (buy), 1 = Ask (sell)
+    uint8_t strategy;           // Index of the strategy that owned the order
+    uint8_t reserved[2];
+} fillRecord;
+
+// Append-only buffered writer for fill records
+typedef struct {
+    FILE *file;
+    unsigned char *buffer;
+    size_t used;
+    long long recordsWritten;
+} fillJournal;
+
+// Running P&L statistics, updated in O(1) per fill and per tick
+typedef struct {
+    bool started;
+    double startEquity;
+    double position;            // Net base position
+    double averageCost;         // Average entry price of the open position
+    double realisedPnL;
+    double unrealisedPnL;
+    double equity;
+    double peakEquity;
+    double maxDrawdown;
+    long long trades;           // Every fill
+    long long closingTrades;    // Fills that reduced the position
+    long long winningTrades;    // Closing fills that realised a profit
+    long long returnCount;      // Welford stats of per-tick equity returns
+    double returnMean;
+    double returnM2;
+} pnlAnalytics;
+
+// Function declarations
+bool journal_open(fillJournal *journal, const char *filename);
+void journal_write_fill(fillJournal *journal, const fillRecord *record);
+void journal_flush(fillJournal *journal);
+void journal_close(fillJournal *journal);
+void analytics_start(pnlAnalytics *stats, double baseBalance, double quoteBalance, double markPrice);
+void analytics_on_fill(pnlAnalytics *stats, bool isBuy, double price, double volume);
+void analytics_on_tick(pnlAnalytics *stats, double markPrice);
+double analytics_win_rate(const pnlAnalytics *stats);
+double analytics_sharpe(const pnlAnalytics *stats);
+
+#endif
\ No newline at end of file
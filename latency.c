@@ -0,0 +1,207 @@
+#include "latency.h"
+#include "alloc_track.h"
+#include <math.h>
+
+// Define the starting number of in-flight events the scheduler can hold before growing
+#define INITIAL_EVENT_CAPACITY 1024
+
+// Latency model in use -- defaults to matching orders on the tick they are made
+static SIM_LOCAL latencyModel model = {LatencyNone, 0, 0, 0, 0};
+static SIM_LOCAL unsigned long long rngState = 0x9E3779B97F4A7C15ULL;
+
+// Current simulated time in both clocks the models can use
+static SIM_LOCAL long long currentTimeNs = 0;
+static SIM_LOCAL long long currentTick = 0;
+
+// Orders that have been sent but haven't reached the book yet
+static SIM_LOCAL eventQueue pendingOrders = {NULL, 0, 0, 0};
+
+
+// Check if event a should leave the queue before event b
+static bool event_before(const scheduledEvent *a, const scheduledEvent *b) {
+    return a->time < b->time || (a->time == b->time && a->seq < b->seq);
+}
+
+
+// Create an empty queue with room for a given number of events
+void event_queue_init(eventQueue *queue, int capacity) {
+    queue->events = malloc(sizeof(scheduledEvent) * capacity);
+    if (!queue->events) {
+        printf("Error Allocating Memory!\n");
+        exit(-1);
+    }
+    queue->count = 0;
+    queue->capacity = capacity;
+    queue->nextSeq = 0;
+}
+
+
+// Add an event to the queue -- O(log4 n)
+void event_queue_push(eventQueue *queue, long long time, void *data) {
+    // Double the heap if it is full
+    if (queue->count == queue->capacity) {
+        int newCapacity = (queue->capacity > 0) ? queue->capacity * 2 : INITIAL_EVENT_CAPACITY;
+        scheduledEvent *grown = realloc(queue->events, sizeof(scheduledEvent) * newCapacity);
+        if (!grown) {
+            printf("Error Allocating Memory!\n");
+            exit(-1);
+        }
+        queue->events = grown;
+        queue->capacity = newCapacity;
+    }
+    scheduledEvent newEvent = {time, queue->nextSeq++, data};
+
+    // Move the hole up until the parent is earlier than the new event
+    int index = queue->count++;
+    while (index > 0) {
+        int parent = (index - 1) / 4;
+        if (!event_before(&newEvent, &queue->events[parent])) {
+            break;
+        }
+        queue->events[index] = queue->events[parent];
+        index = parent;
+    }
+    queue->events[index] = newEvent;
+}
+
+
+// Look at the earliest event without removing it
+scheduledEvent *event_queue_peek(eventQueue *queue) {
+    return (queue->count > 0) ? &queue->events[0] : NULL;
+}
+
+
+// Remove the earliest event from the queue -- O(log4 n)
+bool event_queue_pop(eventQueue *queue, scheduledEvent *out) {
+    if (queue->count == 0) {
+        return false;
+    }
+    *out = queue->events[0];
+    scheduledEvent last = queue->events[--queue->count];
+
+    // Move the hole down, taking the earliest of up to four children each level
+    int index = 0;
+    while (true) {
+        int firstChild = index * 4 + 1;
+        if (firstChild >= queue->count) {
+            break;
+        }
+        int lastChild = (firstChild + 4 < queue->count) ? firstChild + 4 : queue->count;
+        int best = firstChild;
+        for (int child = firstChild + 1; child < lastChild; child++) {
+            if (event_before(&queue->events[child], &queue->events[best])) {
+                best = child;
+            }
+        }
+        if (!event_before(&queue->events[best], &last)) {
+            break;
+        }
+        queue->events[index] = queue->events[best];
+        index = best;
+    }
+    queue->events[index] = last;
+    return true;
+}
+
+
+// Free the queue's storage -- any event data is owned by the caller
+void event_queue_free(eventQueue *queue) {
+    free(queue->events);
+    queue->events = NULL;
+    queue->count = 0;
+    queue->capacity = 0;
+}
+
+
+// xorshift64* -- fast seeded generator for the latency distributions
+static double next_uniform() {
+    rngState ^= rngState >> 12;
+    rngState ^= rngState << 25;
+    rngState ^= rngState >> 27;
+    return ((rngState * 0x2545F4914F6CDD1DULL) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+
+// Choose which latency model new orders use
+void set_latency_model(latencyModel newModel) {
+    model = newModel;
+    if (model.seed != 0) {
+        rngState = model.seed;
+    }
+}
+
+
+// Work out when an order made right now would arrive, in the model's clock
+static long long order_arrival_time() {
+    switch (model.type) {
+        case LatencyFixed:
+            return currentTimeNs + model.fixedNs;
+        case LatencyUniform:
+            return currentTimeNs + model.fixedNs + (long long)(next_uniform() * model.jitterNs);
+        case LatencyExponential:
+            return currentTimeNs + model.fixedNs + (long long)(-log(1.0 - next_uniform()) * model.jitterNs);
+        case LatencyTicks:
+            return currentTick + model.tickDelay;
+        default:
+            return currentTimeNs;
+    }
+}
+
+
+// Move the simulated clocks forward to the tick being processed
+void advance_order_clock(long long tickTimeNs, long long tickIndex) {
+    currentTimeNs = tickTimeNs;
+    currentTick = tickIndex;
+}
+
+
+// Time of the tick currently being processed, in ns
+long long order_clock_time() {
+    return currentTimeNs;
+}
+
+
+// Send an order towards the book -- it only becomes live once it has arrived
+void submit_order(order *newOrder) {
+    if (model.type == LatencyNone) {
+        insert_order_byPointer(newOrder);
+        return;
+    }
+    event_queue_push(&pendingOrders, order_arrival_time(), newOrder);
+}
+
+
+// Make every order that has reached the book by now live, returning how many went live
+int release_arrived_orders() {
+    long long now = (model.type == LatencyTicks) ? currentTick : currentTimeNs;
+    int released = 0;
+    scheduledEvent arrived;
+
+    while (pendingOrders.count > 0 && event_queue_peek(&pendingOrders)->time <= now) {
+        event_queue_pop(&pendingOrders, &arrived);
+        insert_order_byPointer((order*) arrived.data);
+        released++;
+    }
+    return released;
+}
+
+
+// Number of orders still travelling to the book
+int pending_order_count() {
+    return pendingOrders.count;
+}
+
+
+// Free orders that never arrived, releasing their volume from their accounts' risk totals
+void free_pending_orders() {
+    scheduledEvent pending;
+    while (event_queue_pop(&pendingOrders, &pending)) {
+        order *lostOrder = (order*) pending.data;
+        if (lostOrder->orderInfo->account != NULL) {
+            risk_on_release(&lostOrder->orderInfo->account->risk, lostOrder->orderInfo->type, lostOrder->orderInfo->volume);
+        }
+        tracked_free(AllocOrders, lostOrder->orderInfo, sizeof(orderData));
+        tracked_free(AllocOrders, lostOrder, sizeof(order));
+    }
+    event_queue_free(&pendingOrders);
+}
\ No newline at end of file
@@ -0,0 +1,54 @@
+#ifndef LATENCY_H
+#define LATENCY_H
+
+// Standard includes
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+
+// Including other project headers
+#include "matching.h"
+
+// Ways of modelling the delay between deciding on an order and it reaching the book
+typedef enum {LatencyNone, LatencyFixed, LatencyUniform, LatencyExponential, LatencyTicks} latencyType;
+
+// Configuration for order-entry latency
+typedef struct {
+    latencyType type;
+    long long fixedNs;           // Fixed delay (or minimum delay for the distributions)
+    long long jitterNs;          // Uniform: max extra delay, Exponential: mean extra delay
+    int tickDelay;               // LatencyTicks: orders go live this many ticks later
+    unsigned long long seed;     // Seed for the distribution based models
+} latencyModel;
+
+// A single event waiting in the scheduler
+typedef struct {
+    long long time;
+    unsigned long long seq;      // Keeps events with equal times in FIFO order
+    void *data;
+} scheduledEvent;
+
+// 4-ary min-heap of events keyed on int64 timestamps
+typedef struct {
+    scheduledEvent *events;
+    int count;
+    int capacity;
+    unsigned long long nextSeq;
+} eventQueue;
+
+// Function declarations
+void event_queue_init(eventQueue *queue, int capacity);
+void event_queue_push(eventQueue *queue, long long time, void *data);
+scheduledEvent *event_queue_peek(eventQueue *queue);
+bool event_queue_pop(eventQueue *queue, scheduledEvent *out);
+void event_queue_free(eventQueue *queue);
+void set_latency_model(latencyModel model);
+void advance_order_clock(long long tickTimeNs, long long tickIndex);
+long long order_clock_time();
+void submit_order(order *newOrder);
+int release_arrived_orders();
+int pending_order_count();
+void free_pending_orders();
+
+#endif
\ No newline at end of file
@@ -4,106 +4,15 @@
 #include "matching.h"
 #include "strategy.h"
 #include "portfolio_tracker.h"
-
-// Includes for UDP data transfer
-// I'm on windows but will hopefully get Linux working too
-#ifdef _WIN32
-    #include <winsock2.h>
-    #include <ws2tcpip.h>
-#else
-    #include <sys/socket.h>
-    #include <netinet/in.h>
-    #include <arpa/inet.h>
-    #include <unistd.h>
-#endif
-
-
-// Globab UDP socket
-#ifdef _WIN32
-    static SOCKET udp_socket = INVALID_SOCKET;
-#else
-    static int udp_socket = -1;
-#endif
-static struct sockaddr_in server_addr;
-
-
-// Initialise UDP connection
-void init_udp_graphing() {
-    #ifdef _WIN32
-        // initialise Winsock for Windows machine
-        WSADATA wsaData;
-        int result = WSAStartup(MAKEWORD(2,2), &wsaData);
-        if (result != 0) {
-            printf("WSAStartup failed with error %d\n", result);
-            return;
-        }
-
-        udp_socket = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
-        if (udp_socket == INVALID_SOCKET) {
-            printf("Failed to create UDP socket: %d\n", WSAGetLastError());
-            WSACleanup();
-            return;
-        }
-    #else
-        udp_socket = socket(AF_INET, SOCK_DGRAM, 0);
-        if (udp_socket < 0) {
-            printf("Failed to create UDP socket\n");
-        }
-    #endif
-
-    // Set up server address (for python receiver)
-    server_addr.sin_family = AF_INET;
-    // Can access the data through port 8888
-    server_addr.sin_port = htons(8888);
-
-    #ifdef _WIN32
-        // Using localhost
-        server_addr.sin_addr.s_addr = inet_addr("127.0.0.1");
-    #else
-        server_addr.sin_addr.s_addr = inet_addr("127.0.0.1")
-    #endif
-
-    printf("UDP Initialised for graphing - Python script should be running on port 8888\n");
-}
-
-
-// Sending data to python script for graphing
-void send_graph_data(double bid_price, double ask_price, double portfolioValue, int lines_processed) {
-    #ifdef _WIN32
-        // Not initialised
-        if (udp_socket == INVALID_SOCKET) {
-            return;
-        }
-    #else
-        // Not initialised
-        if (udp_socket < 0) {
-            return;
-        }
-    #endif
-
-    // Sending CSV style data
-    char buffer[256];
-    snprintf(buffer, sizeof(buffer), "%d,%.6f,%.6f,%.2f\n", lines_processed, bid_price, ask_price, portfolioValue);
-    
-    sendto(udp_socket, buffer, strlen(buffer), 0, (struct sockaddr*)&server_addr, sizeof(server_addr));
-}
-
-
-// Clean up of UDP socket
-void cleanup_udp() {
-    #ifdef _WIN32
-        if (udp_socket != INVALID_SOCKET) {
-            closesocket(udp_socket);
-            udp_socket = INVALID_SOCKET;
-            WSACleanup();
-        }
-    #else
-        if (udp_socket >= 0) {
-            close(udp_socket);
-            upd_socket = -1;
-        }
-    #endif
-}
+#include "latency.h"
+#include "backtest.h"
+#include "benchmark.h"
+#include "equity_recorder.h"
+#include "perf_trace.h"
+#include "perf_sampler.h"
+#include "telemetry.h"
+#include "telemetry_publisher.h"
+#include "depth_stream.h"
 
 
 //! Global Defines
@@ -111,10 +20,70 @@ void cleanup_udp() {
 #define STANDARD_LOT 100000  // 1 GBP here = 100000 in reality
 #define STARTING_BALANCE 10  // How much USD (in 100,000s) we begin with
 
+// Define the currencies of the traded pair -- the portfolio is valued in the quote currency
+#define BASE_CURRENCY "GBP"
+#define QUOTE_CURRENCY "USD"
+
 // Define our basic support/resistance strategy bounds -- Not necessary if different strategy used
 #define SUPPORT 1.34600
 #define RESISTANCE 1.35300
 
+// Define the adaptive support/resistance strategy -- levels follow the rolling low ask / high bid instead
+// Set ADAPTIVE_SR_ENABLED to 1 to run it alongside the fixed levels (it trades its own account)
+#define ADAPTIVE_SR_ENABLED 0
+#define ADAPTIVE_SR_WINDOW_TICKS 5000     // Window length in ticks
+#define ADAPTIVE_SR_WINDOW_NS 0           // Use a time window instead if > 0 (ticks then caps samples kept)
+#define ADAPTIVE_SR_SUPPORT_BUFFER 0.00000
+#define ADAPTIVE_SR_RESISTANCE_BUFFER 0.00000
+
+// Define how long our orders take to reach the book -- LatencyNone matches orders on the tick they are made
+// Options: {LatencyFixed, fixedNs}, {LatencyUniform, minNs, jitterNs}, {LatencyExponential, minNs, meanNs}, {LatencyTicks, 0, 0, ticks}
+#define ORDER_LATENCY {LatencyFixed, 500000, 0, 0, 42}
+
+// Define the pre-trade risk limits every new order must pass -- 0 turns a limit off
+// {max net position incl. resting orders (lots), max order volume (lots), max order notional (quote, in 100,000s), max orders per window per account, window (ns), price band from mid}
+#define RISK_LIMITS {50, 20, 30, 50, 1000000000LL, 0.00500}
+
+// Define whether every fill is written to a binary journal (48 byte fillRecords, see journal.h)
+#define FILL_JOURNAL_ENABLED 1
+#define FILL_JOURNAL_FILE "fill_journal.bin"
+
+// Define whether each tick's prices, balances and value are recorded to a columnar file (read back with --dump-equity <file>)
+#define EQUITY_RECORDER_ENABLED 0
+#define EQUITY_RECORDER_FILE "equity.bin"
+
+// Define whether the replay (or sweep) is profiled by sampling the call stack on a CPU time interval timer
+#define SAMPLING_PROFILER_ENABLED 0
+#define SAMPLING_PROFILER_HZ 997                    // Samples per second of CPU time -- off a round number to avoid lockstep with periodic work
+#define SAMPLING_PROFILER_FILE "profile.folded"     // Folded stacks for flamegraph.pl or speedscope
+
+// Define where graphing.py listens for telemetry -- ticks are downsampled into bars and history points (below), batched per datagram
+// Set TELEMETRY_SHM_ENABLED to 1 to publish into a shared memory ring instead (run graphing.py --shm) -- UDP is used if it can't be opened
+#define TELEMETRY_HOST "127.0.0.1"
+#define TELEMETRY_SHM_ENABLED 0
+
+// Define how telemetry is downsampled before it is sent -- bars of TELEMETRY_BUCKET_TICKS ticks (or TELEMETRY_BUCKET_NS of tick time if > 0)
+// with bid/ask open/high/low/close, plus a long history of every bar reduced to TELEMETRY_HISTORY_POINTS points per series with LTTB
+#define TELEMETRY_BUCKET_TICKS 50
+#define TELEMETRY_BUCKET_NS 0
+#define TELEMETRY_HISTORY_POINTS 2000
+
+// Define whether the book's depth is streamed for graphing.py --depth to draw as a heatmap -- the top DEPTH_STREAM_LEVELS levels
+// per side (up to DEPTH_MAX_LEVELS) every DEPTH_STREAM_EVERY_TICKS ticks, sent as changed levels with a full snapshot every DEPTH_SNAPSHOT_EVERY updates
+#define DEPTH_STREAM_ENABLED 0
+#define DEPTH_STREAM_LEVELS 10
+#define DEPTH_STREAM_EVERY_TICKS 1
+#define DEPTH_SNAPSHOT_EVERY 500
+
+// Define the grid searched when run with --sweep -- every support/resistance pair is backtested
+#define SWEEP_SUPPORT_FROM 1.34400
+#define SWEEP_SUPPORT_TO 1.34800
+#define SWEEP_RESISTANCE_FROM 1.35100
+#define SWEEP_RESISTANCE_TO 1.35500
+#define SWEEP_STEP 0.00050
+#define SWEEP_THREADS 0     // 0 uses every core
+#define SWEEP_BLOCK_REPLAY 1    // Only fully process ticks that could trigger the levels
+
 
 //! Some global declarations/definitions
 // Create an orderline struct to hold read-in data
@@ -125,55 +94,144 @@ orderLine ol;
 char filename[] = "GBPUSD_SHORTER_ticks.csv";
 
 // Initialise bid and ask trees
-treeStruct bidTree = {Bid, NULL, 0};
-treeStruct askTree = {Ask, NULL, 0};
+SIM_LOCAL treeStruct bidTree = {Bid, NULL, 0};
+SIM_LOCAL treeStruct askTree = {Ask, NULL, 0};
 
 // Define a global user and their initial quoteCurrencyBalance
-userAccount user = {0, STARTING_BALANCE};
+SIM_LOCAL userAccount user = {0, STARTING_BALANCE};
+
+// Levels used by the registered support/resistance strategy
+supportResistanceState srLevels = {SUPPORT, RESISTANCE};
+
+// Adaptive support/resistance strategy and the account it trades
+adaptiveSupportResistanceState adaptiveLevels;
+userAccount adaptiveUser = {0, STARTING_BALANCE};
 
 
-// Main function call
-int main() {
+// Backtest every support/resistance pair in the sweep grid over one in-memory copy of the data
+int run_sweep_mode() {
+   tickData ticks = load_tick_file(filename);
+
+   // Build the grid of parameters to try
+   int supportSteps = (int)((SWEEP_SUPPORT_TO - SWEEP_SUPPORT_FROM) / SWEEP_STEP + 1.5);
+   int resistanceSteps = (int)((SWEEP_RESISTANCE_TO - SWEEP_RESISTANCE_FROM) / SWEEP_STEP + 1.5);
+   int count = supportSteps * resistanceSteps;
+   sweepParams *grid = malloc(sizeof(sweepParams) * count);
+   sweepResult *results = malloc(sizeof(sweepResult) * count);
+   if (!grid || !results) {
+      printf("Error Allocating Memory!\n");
+      exit(-1);
+   }
+   for (int i = 0; i < supportSteps; i++) {
+      for (int j = 0; j < resistanceSteps; j++) {
+         grid[i * resistanceSteps + j] = (sweepParams){SWEEP_SUPPORT_FROM + i * SWEEP_STEP, SWEEP_RESISTANCE_FROM + j * SWEEP_STEP};
+      }
+   }
+
+   sweepConfig config = {STARTING_BALANCE, ORDER_LATENCY, SWEEP_THREADS, SWEEP_BLOCK_REPLAY, RISK_LIMITS};
+   if (SAMPLING_PROFILER_ENABLED) {
+      sampler_start(SAMPLING_PROFILER_HZ);
+   }
+   double start = get_time_ms();
+   run_parameter_sweep(&ticks, grid, count, &config, results);
+   double elapsed = get_time_ms() - start;
+   if (SAMPLING_PROFILER_ENABLED) {
+      sampler_report(SAMPLING_PROFILER_FILE);
+   }
+
+   print_sweep_results(results, count, STANDARD_LOT);
+   printf("\nSweep finished in %.1f ms (%.0f ticks/s across all instances)\n", elapsed, (double)ticks.count * count / (elapsed / 1000.0));
+
+   free(grid);
+   free(results);
+   free_tick_data(&ticks);
+   return 0;
+}
+
+
+// Main function call -- run with --sweep to search the support/resistance grid instead of a single live replay
+// or --bench-indicators to time the streaming indicator updates, --dump-equity <file> to print a recorded equity file,
+// or --trace-to-csv <trace> <csv> to convert a perf trace to the CSV log layout
+int main(int argc, char *argv[]) {
+   if (argc > 1 && strcmp(argv[1], "--sweep") == 0) {
+      return run_sweep_mode();
+   }
+   if (argc > 1 && strcmp(argv[1], "--bench-indicators") == 0) {
+      benchmark_indicators();
+      return 0;
+   }
+   if (argc > 2 && strcmp(argv[1], "--dump-equity") == 0) {
+      return dump_equity_file(argv[2]);
+   }
+   if (argc > 3 && strcmp(argv[1], "--trace-to-csv") == 0) {
+      return trace_to_csv(argv[2], argv[3]);
+   }
+
    // Initialise hash table
    initHashTable();
 
-   // Initialise UDP
-   init_udp_graphing();
+   // Open the telemetry channel for graphing.py
+   telemetrySender telemetry;
+   if (!TELEMETRY_SHM_ENABLED || !telemetry_open_shm(&telemetry, TELEMETRY_RING_NAME, TELEMETRY_RING_SLOTS)) {
+      telemetry_open(&telemetry, TELEMETRY_HOST, TELEMETRY_PORT);
+   }
+   // Packing and sending happen on the publisher thread so a slow socket never holds up a tick
+   publisher_start(&telemetry, TELEMETRY_BUCKET_TICKS, TELEMETRY_BUCKET_NS, TELEMETRY_HISTORY_POINTS, DEPTH_STREAM_ENABLED ? DEPTH_SNAPSHOT_EVERY : 0);
+
+   // Choose how delayed our orders are before they can be matched
+   set_latency_model((latencyModel)ORDER_LATENCY);
+
+   // Set the limits the risk gate checks each new order against
+   set_risk_limits((riskLimits)RISK_LIMITS);
+
+   // Open the fill journal so each fill is recorded as it happens
+   fillJournal journal;
+   if (FILL_JOURNAL_ENABLED && journal_open(&journal, FILL_JOURNAL_FILE)) {
+      set_fill_journal(&journal);
+   }
+
+   // Open the per-tick equity recorder
+   equityRecorder equity = {NULL, NULL, 0, 0};
+   if (EQUITY_RECORDER_ENABLED) {
+      equity_recorder_open(&equity, EQUITY_RECORDER_FILE);
+   }
+
+   // Register the strategies to run -- each trades its own account, so more can be added side by side
+   // e.g. register_strategy(&supportResistanceStrategy, &otherLevels, &otherUser);
+   register_strategy(&supportResistanceStrategy, &srLevels, &user);
+   if (ADAPTIVE_SR_ENABLED) {
+      adaptive_sr_init(&adaptiveLevels, ADAPTIVE_SR_WINDOW_TICKS, ADAPTIVE_SR_WINDOW_NS, ADAPTIVE_SR_SUPPORT_BUFFER, ADAPTIVE_SR_RESISTANCE_BUFFER);
+      register_strategy(&adaptiveSupportResistanceStrategy, &adaptiveLevels, &adaptiveUser);
+   }
+   strategies_init();
 
    // Value for controlling flow of outputting data
    int lines_processed = 0;
 
+   // Top of book handed to strategies each tick
+   bookView book = {0};
+
+   // Portfolio valued through the pair's book -- more pairs and currencies can be added to the graph
+   multiPortfolio portfolio;
+   portfolio_init(&portfolio);
+   int baseCurrency = portfolio_add_currency(&portfolio, BASE_CURRENCY);
+   int quoteCurrency = portfolio_add_currency(&portfolio, QUOTE_CURRENCY);
+   int tradedPair = portfolio_add_pair(&portfolio, baseCurrency, quoteCurrency);
+   portfolio_set_valuation_currency(&portfolio, quoteCurrency);
+
    // Initialise file pointer - so we can leave file open
    FILE *fp = open_data_file(filename);
 
+   // Sample the replay loop rather than instrumenting it
+   if (SAMPLING_PROFILER_ENABLED) {
+      sampler_start(SAMPLING_PROFILER_HZ);
+   }
+
    while (read_next_line(fp, &ol) > 0) {
       lines_processed++;
 
-      // Creates node in the bid tree
-      node *bid_node = malloc(sizeof(node));
-      if (!bid_node) {
-         printf("Error Allocating Memory!\n");
-         exit(-1);
-      }
-      *bid_node = (node){ol.bidPrice, ol.bidVolume, Red, NULL, NULL, NULL};
-
-      // Creates node in the ask tree
-      node *ask_node = malloc(sizeof(node));
-      if (!ask_node) {
-         printf("Error Allocating Memory!\n");
-         exit(-1);
-      }
-      *ask_node = (node){ol.askPrice, ol.askVolume, Red, NULL, NULL, NULL};
-
-      // Inserts these new nodes
-      insert_node(&bidTree, bid_node);
-      insert_node(&askTree, ask_node);
-
-      // Create new orders based on strategy -- Support/Resistance
-      check_and_react_supportResistance(SUPPORT, RESISTANCE);
-
-      // Try to complete orders with updated order book
-      match_all_orders();
+      // Run the tick through the book, strategies and matching engine
+      process_tick(&ol, tick_timestamp_ns(&ol), lines_processed, &book);
 
       // Keep track of the last best bid for ouputting reasons
       node *curr_best_bid = find_best_node(&bidTree);
@@ -183,21 +241,54 @@ int main() {
       double best_bid_price = (curr_best_bid != NULL) ? curr_best_bid->price : 0.0f;
       double best_ask_price = (curr_best_ask != NULL) ? curr_best_ask->price : 0.0f;
 
-      // Calculate current portfolio value based on best bid price
-      double portfolioValue = (user.baseCurrencyBalance*best_bid_price)+user.quoteCurrencyBalance;
+      // Keep the portfolio in step -- its value is only worked out again when something it depends on changes
+      portfolio_update_book(&portfolio, tradedPair, best_bid_price, best_ask_price);
+      portfolio_sync_account(&portfolio, baseCurrency, quoteCurrency, &user);
+
+      // Record the tick for later analysis -- buffered, so this is only a few stores per tick
+      if (EQUITY_RECORDER_ENABLED) {
+         equity_record(&equity, book.timestamp, best_bid_price, best_ask_price, user.baseCurrencyBalance, user.quoteCurrencyBalance, portfolio_value(&portfolio));
+      }
+
+      // Stream every tick to the grapher -- a 40 byte copy into the publisher's queue
+      tickRecord tickSample = {lines_processed, book.timestamp, best_bid_price, best_ask_price, portfolio_value(&portfolio)};
+      publisher_push_tick(&tickSample);
 
-      // Only send graph data every 500 CSV lines - We read ~20,000/s so we still write ~40 time/s
-      if (lines_processed % 500 == 0) {
-         // Write what has happened to outer file - acts as ledger and graphing
-         send_graph_data(best_bid_price, best_ask_price, portfolioValue, lines_processed);
+      // Capture the top of the book's depth -- the publisher works out which levels changed
+      if (DEPTH_STREAM_ENABLED && lines_processed % DEPTH_STREAM_EVERY_TICKS == 0) {
+         depthSnapshot depth;
+         depth_capture(&depth, &bidTree, &askTree, DEPTH_STREAM_LEVELS, lines_processed);
+         publisher_push_depth(&depth);
       }
    }
+   // Let strategies know the data has finished
+   strategies_on_end(&book);
+   if (SAMPLING_PROFILER_ENABLED) {
+      sampler_report(SAMPLING_PROFILER_FILE);
+   }
+
+   publisher_stop();
+   telemetry_close(&telemetry);
+
    // Clean up remaining orders
    freeHashTable();
+   free_pending_orders();
    fclose(fp);
+   if (FILL_JOURNAL_ENABLED) {
+      set_fill_journal(NULL);
+      journal_close(&journal);
+   }
+   if (EQUITY_RECORDER_ENABLED) {
+      equity_recorder_close(&equity);
+   }
 
    // Calculate final Portfolio Value and print
    double end_balance = (user.baseCurrencyBalance*(find_best_node(&bidTree)->price))+user.quoteCurrencyBalance;
    printf("Total Value in USD after end of file:\n Start Balance: %d\n End Balance: %lf\n P/L: %lf\n", STARTING_BALANCE*STANDARD_LOT, (end_balance)*STANDARD_LOT, (end_balance-STARTING_BALANCE)*STANDARD_LOT);
+   print_strategy_results(find_best_node(&bidTree)->price);
+   print_risk_report();
+   if (ADAPTIVE_SR_ENABLED) {
+      adaptive_sr_free(&adaptiveLevels);
+   }
    return 0;
 }
\ No newline at end of file
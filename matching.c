@@ -1,18 +1,16 @@
 #include "matching.h"
-
-// Define max size of hashtable to be prime number
-#define SIZE 103
+#include "alloc_track.h"
 
 // Hash table array
-order* hashArray[SIZE];
+SIM_LOCAL order* hashArray[ORDER_TABLE_SIZE];
 
 // Keep track of hashtable's free space
-int freeSpace = SIZE;
+SIM_LOCAL int freeSpace = ORDER_TABLE_SIZE;
 
 
 // Hash function - uses orderID as the key
 int hashCode(int orderID) {
-   return orderID % SIZE;
+   return orderID % ORDER_TABLE_SIZE;
 }
 
 
@@ -21,8 +19,10 @@ order *search_orders(int orderID) {
    // Get the hash 
    int hashIndex = hashCode(orderID);  
 	
-   // Move in array until an empty slot
-   while(hashArray[hashIndex] != NULL) {
+   int probes = 0;
+   
+   // Move in array until an empty slot -- or we've checked every slot of a full table
+   while(hashArray[hashIndex] != NULL && probes++ < ORDER_TABLE_SIZE) {
 	
       if(hashArray[hashIndex]->orderID == orderID)
          return hashArray[hashIndex]; 
@@ -31,13 +31,21 @@ order *search_orders(int orderID) {
       hashIndex++;
 		
       // Wrap around the table
-      hashIndex %= SIZE;
+      hashIndex %= ORDER_TABLE_SIZE;
    }        
 	
    return NULL;        
 }
 
 
+// Stop counting an order's unfilled volume against its account's risk limits -- it's leaving the table unfilled
+static void release_order(order *orderPtr) {
+   if (orderPtr->orderInfo != NULL && orderPtr->orderInfo->account != NULL) {
+      risk_on_release(&orderPtr->orderInfo->account->risk, orderPtr->orderInfo->type, orderPtr->orderInfo->volume);
+   }
+}
+
+
 // Insert an order into the hashtable
 void insert_order_byPointer(order* orderPtr) {
    // Don't add NULL pointer to active orders
@@ -54,7 +62,7 @@ void insert_order_byPointer(order* orderPtr) {
       hashIndex++;
 		
       // Wrap around the table
-      hashIndex %= SIZE;
+      hashIndex %= ORDER_TABLE_SIZE;
    }
 	// Insert order into table and update freeSpace
    hashArray[hashIndex] = orderPtr;
@@ -73,8 +81,10 @@ void delete_order_byPointer(order* orderPtr) {
    // Get the hash 
    int hashIndex = hashCode(orderID);
    
-   // Move in array until an empty slot
-   while(hashArray[hashIndex] != NULL) {
+   int probes = 0;
+   
+   // Move in array until an empty slot -- or we've checked every slot of a full table
+   while(hashArray[hashIndex] != NULL && probes++ < ORDER_TABLE_SIZE) {
 	
       if(hashArray[hashIndex]->orderID == orderID) {
          order* temp = hashArray[hashIndex]; 
@@ -83,10 +93,11 @@ void delete_order_byPointer(order* orderPtr) {
          hashArray[hashIndex] = NULL;
          
          // Free the memory
+         release_order(temp);
          if(temp->orderInfo != NULL) {
-            free(temp->orderInfo);
+            tracked_free(AllocOrders, temp->orderInfo, sizeof(orderData));
          }
-         free(temp);
+         tracked_free(AllocOrders, temp, sizeof(order));
          freeSpace++;
          return;
       }
@@ -95,7 +106,7 @@ void delete_order_byPointer(order* orderPtr) {
       hashIndex++;
 		
       // Wrap around the table
-      hashIndex %= SIZE;
+      hashIndex %= ORDER_TABLE_SIZE;
    }            
 }
 
@@ -105,8 +116,10 @@ void delete_order_byID(int orderID) {
    // Get the hash 
    int hashIndex = hashCode(orderID);
    
-   // Move in array until an empty slot
-   while(hashArray[hashIndex] != NULL) {
+   int probes = 0;
+   
+   // Move in array until an empty slot -- or we've checked every slot of a full table
+   while(hashArray[hashIndex] != NULL && probes++ < ORDER_TABLE_SIZE) {
 	
       if(hashArray[hashIndex]->orderID == orderID) {
          order* temp = hashArray[hashIndex]; 
@@ -115,10 +128,11 @@ void delete_order_byID(int orderID) {
          hashArray[hashIndex] = NULL; 
 
         // Free the memory
+         release_order(temp);
          if(temp->orderInfo != NULL) {
-            free(temp->orderInfo);
+            tracked_free(AllocOrders, temp->orderInfo, sizeof(orderData));
          }
-         free(temp);
+         tracked_free(AllocOrders, temp, sizeof(order));
          freeSpace++;
          return;
       }
@@ -127,7 +141,7 @@ void delete_order_byID(int orderID) {
       hashIndex++;
 		
       // Wrap around the table
-      hashIndex %= SIZE;
+      hashIndex %= ORDER_TABLE_SIZE;
    }             
 }
 
@@ -135,7 +149,7 @@ void delete_order_byID(int orderID) {
 // Display all orders in the hash table -- FOR DEBUGGING
 void display() {
    int i = 0;
-   for(i = 0; i < SIZE; i++) {
+   for(i = 0; i < ORDER_TABLE_SIZE; i++) {
       if(hashArray[i] != NULL) {
          printf(" [ID:%d, Type:%s, Price:%.2f, Vol:%.2f, Fill:%s]", 
                 hashArray[i]->orderID,
@@ -154,22 +168,32 @@ void display() {
 // Initialize the hash table
 void initHashTable() {
    // Initialize all slots to NULL
-   for(int i = 0; i < SIZE; i++) {
+   for(int i = 0; i < ORDER_TABLE_SIZE; i++) {
       hashArray[i] = NULL;
    }
+   freeSpace = ORDER_TABLE_SIZE;
 }
 
 
 // Free remaining orders in orderList
 void freeHashTable() {
-   for(int i = 0; i < SIZE; i++) {
+   for(int i = 0; i < ORDER_TABLE_SIZE; i++) {
       if(hashArray[i] != NULL) {
+         release_order(hashArray[i]);
          if(hashArray[i]->orderInfo != NULL) {
-            free(hashArray[i]->orderInfo);
+            tracked_free(AllocOrders, hashArray[i]->orderInfo, sizeof(orderData));
          }
-         free(hashArray[i]);
+         tracked_free(AllocOrders, hashArray[i], sizeof(order));
+         hashArray[i] = NULL;
       }
    }
+   freeSpace = ORDER_TABLE_SIZE;
+}
+
+
+// Number of orders currently live in the hash table
+int open_order_count() {
+   return ORDER_TABLE_SIZE - freeSpace;
 }
 
 
@@ -195,13 +219,13 @@ bool price_better_or_equal(order *curr_order, double nodePrice) {
 int valid_match(treeStruct *tree, order *curr_order, userAccount *user) { 
    // Find best current node in desired orderbook side
    node *match_node = find_best_node(tree);
-   // Check if price is good enough for current order if required
-   bool priceGoodEnough = price_better_or_equal(curr_order, match_node->price);
 
    // No valid match
    if (match_node == NULL){
       return -1;  // No valid match
    }
+   // Check if price is good enough for current order if required
+   bool priceGoodEnough = price_better_or_equal(curr_order, match_node->price);
    while (match_node != NULL) {
 
       // Full valid match
@@ -210,15 +234,18 @@ int valid_match(treeStruct *tree, order *curr_order, userAccount *user) {
          if (curr_order->orderInfo->volume == match_node->volume) {
             // Update portfolio from trade completing
             update_portfolio(curr_order->orderInfo->type, match_node->price, curr_order->orderInfo->volume, user);
+            report_fill(curr_order, match_node->price, curr_order->orderInfo->volume);
             // Remove node from order book
             delete_node(tree, match_node);
          } else {
             // Update portfolio from trade completing
             update_portfolio(curr_order->orderInfo->type, match_node->price, curr_order->orderInfo->volume, user);
+            report_fill(curr_order, match_node->price, curr_order->orderInfo->volume);
             // Update volume of node in order book
             update_node_volume(tree, match_node, -(curr_order->orderInfo->volume));
          }
-         // Delete order since it will be fulfilled
+         // Delete order since it will be fulfilled -- none of it is left to release
+         curr_order->orderInfo->volume = 0;
          delete_order_byPointer(curr_order);
          return 1;  // Full valid match --- might not need this
 
@@ -229,15 +256,20 @@ int valid_match(treeStruct *tree, order *curr_order, userAccount *user) {
             curr_order->orderInfo->volume -= match_node->volume;
             // Update portfolio to keep it up to date
             update_portfolio(curr_order->orderInfo->type, match_node->price, match_node->volume, user);
+            report_fill(curr_order, match_node->price, match_node->volume);
             node *temp = match_node;
             // Find next best node to try and complete order with
             match_node = find_next_best(tree, match_node);
-            // If the order is a limit order and we pass the desired price we terminate
-            if (curr_order->orderInfo->fill == Limit && match_node->price > curr_order->orderInfo->price) {
+            // We delete the node as we use up all it's volume -- before stopping too, or it stays as phantom liquidity
+            delete_node(tree, temp);
+            // If the book runs out, or the order is a limit order and the next level is past its price we terminate
+            if (match_node == NULL) {
                return 0;  // Denote a partial order completion
             }
-            // We delete the node as we use up all it's volume
-            delete_node(tree, temp);
+            priceGoodEnough = price_better_or_equal(curr_order, match_node->price);
+            if (curr_order->orderInfo->fill == Limit && !priceGoodEnough) {
+               return 0;
+            }
          // Order is a limit type and the current node isn't good enough at all
          } else {
             return -1;
@@ -252,11 +284,11 @@ int valid_match(treeStruct *tree, order *curr_order, userAccount *user) {
 // Iterate over order hash table and try to resolve them
 void match_all_orders() {
    // Create a buffer to hold the orders that need updating
-   order *orders_to_process[SIZE];
+   order *orders_to_process[ORDER_TABLE_SIZE];
    int order_count = 0;
 
    // Locate orders to update
-   for (int i = 0; i < SIZE; i++) {
+   for (int i = 0; i < ORDER_TABLE_SIZE; i++) {
       if (hashArray[i] != NULL) {
          orders_to_process[order_count] = hashArray[i];
          order_count++;
@@ -269,7 +301,7 @@ void match_all_orders() {
          // Choose correct tree to search
          treeStruct *tree_to_choose = (curr_order->orderInfo->type == Bid) ?  &askTree : &bidTree;
          // Try to resolve order
-         int outcome = valid_match(tree_to_choose, curr_order, &user);
+         int outcome = valid_match(tree_to_choose, curr_order, curr_order->orderInfo->account);
          /* //Display new balance if changes made -- Good for debugging
          if (outcome >= 0) {
             printf("- User Balances -\n GBP: %lf\n USD: %lf\n", user.baseCurrencyBalance, user.quoteCurrencyBalance);
@@ -11,6 +11,9 @@
 #include "order_book.h"
 #include "portfolio_tracker.h"
 
+// Define max size of the open order hashtable to be prime number
+#define ORDER_TABLE_SIZE 103
+
 // New enum for another differentiator
 typedef enum {Market, Limit} orderType;
 
@@ -20,6 +23,8 @@ typedef struct {
     double price;
     double volume;
     orderType fill;
+    int owner;              // Index of the strategy that placed the order (-1 if none)
+    userAccount *account;   // Account the order trades for
 } orderData;
 
 // Struct to hold key,value pair for an order
@@ -29,10 +34,10 @@ typedef struct {
 } order;
 
 // Declare project global variables
-extern userAccount user;
-extern int freeSpace;
-extern treeStruct bidTree;
-extern treeStruct askTree;
+extern SIM_LOCAL userAccount user;
+extern SIM_LOCAL int freeSpace;
+extern SIM_LOCAL treeStruct bidTree;
+extern SIM_LOCAL treeStruct askTree;
 
 // Function declarations
 int hashCode(int orderID);
@@ -43,8 +48,12 @@ void delete_order_byID(int orderID);
 void display();
 void initHashTable();
 void freeHashTable();
+int open_order_count();
 bool price_better_or_equal(order *curr_order, double nodePrice);
 int valid_match(treeStruct *tree, order *curr_order, userAccount *user);
 void match_all_orders();
 
+// Defined in strategy.c -- passes fills back to the strategy that owns the order
+void report_fill(order *filledOrder, double price, double volume);
+
 #endif
\ No newline at end of file
@@ -1,8 +1,21 @@
 #include "order_book.h"
+#include "alloc_track.h"
 
 // Define how many nodes we want to have in each red-black tree
 #define MAX_TREE_SIZE 1000
 
+// Number of price levels each tree currently keeps before removing its worst level
+static int treeCapacity = 10;
+
+
+// Change how many price levels a tree keeps -- capped at MAX_TREE_SIZE
+void set_max_tree_size(int size) {
+    if (size < 1) {
+        size = 1;
+    }
+    treeCapacity = (size > MAX_TREE_SIZE) ? MAX_TREE_SIZE : size;
+}
+
 
 // Insert new nodes into the tree until it's max-size is reached
 void insert_node(treeStruct *tree, node *new_node) {
@@ -43,7 +56,7 @@ void insert_node(treeStruct *tree, node *new_node) {
                 balance_tree_insert(tree, new_node);
                 tree->size += 1;
                 // If tree is full, remove worst node - may be node we just added
-                if (tree->size > 10) {
+                if (tree->size > treeCapacity) {
                     curr_node = find_worst_node(tree);
                     delete_node(tree, curr_node);
                 }
@@ -60,7 +73,7 @@ void insert_node(treeStruct *tree, node *new_node) {
                 balance_tree_insert(tree, new_node);
                 tree->size += 1;
                 // If tree is full, remove worst node - may be node we just added
-                if (tree->size > 10) {
+                if (tree->size > treeCapacity) {
                     curr_node = find_worst_node(tree);
                     delete_node(tree, curr_node);
                 }
@@ -71,7 +84,7 @@ void insert_node(treeStruct *tree, node *new_node) {
         // If we find a node at the same price level, update volume there
         } else {
             curr_node->volume += new_node->volume;
-            free(new_node);
+            tracked_free(AllocBookNodes, new_node, sizeof(node));
             return;
         }
     }
@@ -188,11 +201,14 @@ void delete_node(treeStruct *tree, node *delNode) {
     node *fixup_parent = NULL;
     nodeColour deleted_color = delNode->colour;
     bool deleted_was_left_child = false;
+    // Side of fixup_parent the removed node was on -- differs from delNode's side when a successor moves up
+    bool fixup_was_left_child = false;
 
     // Track if delNode was a left child of its parent
     if (delNode->parent != NULL) {
         deleted_was_left_child = (delNode == delNode->parent->left) ? true : false;
     }
+    fixup_was_left_child = deleted_was_left_child;
     // Node has no children
     if (delNode->left == NULL && delNode->right == NULL) {
         fixup_parent = delNode->parent;
@@ -230,12 +246,12 @@ void delete_node(treeStruct *tree, node *delNode) {
         if (successor->parent == delNode) {
             // Successor is direct right child of delNode
             fixup_parent = successor;
-            deleted_was_left_child = false; 
+            fixup_was_left_child = false;
         } else {
             // Successor is further down the tree
             fixup_parent = successor->parent;
             // successor is always left child of its parent
-            deleted_was_left_child = true; 
+            fixup_was_left_child = true;
             
             // Remove successor from its current position
             successor->parent->left = successor->right;
@@ -262,12 +278,12 @@ void delete_node(treeStruct *tree, node *delNode) {
             delNode->parent->right = successor;
         }
     }
-    free(delNode);
+    tracked_free(AllocBookNodes, delNode, sizeof(node));
     delNode = NULL;
     
     // If we deleted a black node, we may need to rebalance
     if (deleted_color == Black) {
-        balance_tree_delete(tree, fixup_node, fixup_parent, deleted_was_left_child);
+        balance_tree_delete(tree, fixup_node, fixup_parent, fixup_was_left_child);
     }
     // Make tree size smaller to allow new node to be added
     tree->size -= 1;
@@ -371,23 +387,20 @@ void balance_tree_delete(treeStruct *tree, node *fixup_node, node *parent, bool
 
 // Used for deleting all nodes better than new best
 void recursive_delete(treeStruct *tree, node *curr_node, node *best_node) {
-    if (curr_node == NULL) {
-        return;
-    }
-
-    // Delete all it's children first - ensures memory freed correctly
-    recursive_delete(tree, curr_node->left, best_node);
-    recursive_delete(tree, curr_node->right, best_node);
-
-    // Depending on tree we look for higher or lower prices
-    if (tree->type == Bid) {
-        if (curr_node->price > best_node->price) {
-            delete_node(tree, curr_node);
-        }
-    } else {
-        if (curr_node->price < best_node->price) {
-            delete_node(tree, curr_node);
+    /* Nodes better than the new best all sit at the best end of the tree, so peel them off
+       from there. Walking the subtree while deleting isn't safe as rebalancing rotations
+       move nodes we haven't visited yet (and can free ones we are about to visit)
+    */
+    curr_node = find_best_node(tree);
+    while (curr_node != NULL) {
+        // Depending on tree we look for higher or lower prices
+        if (tree->type == Bid && curr_node->price <= best_node->price) {
+            return;
+        } else if (tree->type == Ask && curr_node->price >= best_node->price) {
+            return;
         }
+        delete_node(tree, curr_node);
+        curr_node = find_best_node(tree);
     }
 }
 
@@ -539,7 +552,7 @@ void free_nodes(node *curr_node) {
     free_nodes(curr_node->right);
 
     // Now free our node - ensures all memory is freed
-    free(curr_node);
+    tracked_free(AllocBookNodes, curr_node, sizeof(node));
 }
 
 
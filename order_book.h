@@ -7,6 +7,13 @@
 #include <stdlib.h>
 #include <stdbool.h>
 
+// Simulator state is thread local so parameter sweep workers each get their own instance
+#ifdef _MSC_VER
+    #define SIM_LOCAL __declspec(thread)
+#else
+    #define SIM_LOCAL _Thread_local
+#endif
+
 // Enums defined for basic differentiators
 typedef enum {Red, Black} nodeColour;
 typedef enum {Bid, Ask} tradeType; 
@@ -29,6 +36,7 @@ typedef struct {
 } treeStruct;
 
 // Function Declarations
+void set_max_tree_size(int size);
 void insert_node(treeStruct *tree, node *new_node);
 void balance_tree_insert(treeStruct *tree, node *curr_node);
 void trinode_right_rotation(treeStruct *tree, node *curr_node);
@@ -0,0 +1,340 @@
+#include "perf_counters.h"
+#include "order_book.h"
+#include <stdatomic.h>
+
+#if defined(__linux__)
+    #include <errno.h>
+    #include <linux/perf_event.h>
+    #include <sys/mman.h>
+    #include <sys/syscall.h>
+    #include <time.h>
+    #include <unistd.h>
+    #if defined(__x86_64__) || defined(__i386__)
+        #include <x86intrin.h>
+        #define HW_HAVE_RDPMC 1
+    #endif
+#endif
+
+// Counters opened for one thread -- perf events opened with pid 0 only count the thread that opened them. As many
+// as possible go in one group led by the first that opens, so they are always scheduled onto the PMU together and
+// their counts cover the same time; any that can't join the group are opened on their own
+typedef struct {
+    bool tried;
+    bool usable;
+    int fds[HwCounterCount];
+    int leader;                         // Counter leading the group, -1 if none opened
+    int groupSlot[HwCounterCount];      // Position in the group's read() values, -1 if opened on its own
+    int groupSize;
+#if defined(__linux__)
+    struct perf_event_mmap_page *pages[HwCounterCount];
+#endif
+} threadCounters;
+
+static SIM_LOCAL threadCounters counters;
+
+// Why counters are or aren't available, for the summary
+static char statusText[128] = "not opened";
+
+// Counters whose counts have been scaled because the kernel multiplexed them -- one bit per counter
+static atomic_uint multiplexedCounters = 0;
+
+
+#if defined(__linux__)
+// How long a new group is given to get onto the PMU before it is treated as unschedulable
+#define HW_GROUP_CHECK_NS 2000000ULL
+
+// Time and count fields every read() returns
+#define HW_READ_TIMES (PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING)
+
+// perf event type and config for each counter
+static const struct {
+    unsigned int type;
+    unsigned long long config;
+} hwEvents[HwCounterCount] = {
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_INSTRUCTIONS},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+    {PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+};
+
+
+// Open one counter, in the group led by groupFd or on its own if groupFd is -1
+static int open_event(int i, int groupFd) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = hwEvents[i].type;
+    attr.config = hwEvents[i].config;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = HW_READ_TIMES | ((groupFd >= 0 || counters.leader < 0) ? PERF_FORMAT_GROUP : 0);
+    return (int) syscall(SYS_perf_event_open, &attr, 0, -1, groupFd, 0);
+}
+
+
+// Scale a count for the time its counter was actually on the PMU, noting the counters that had to be
+static unsigned long long scale_count(unsigned long long count, unsigned long long enabled, unsigned long long running, unsigned int mask) {
+    if (running == 0) {
+        return 0;
+    }
+    if (running < enabled) {
+        atomic_fetch_or_explicit(&multiplexedCounters, mask, memory_order_relaxed);
+        return (unsigned long long) ((double) count * enabled / running);
+    }
+    return count;
+}
+
+
+// Read the group in one read() -- the leader returns every member's count and the group's times
+static bool read_group_counts(unsigned long long counts[HwCounterCount], unsigned long long *enabled, unsigned long long *running) {
+    unsigned long long buffer[3 + HwCounterCount];
+    ssize_t expected = (ssize_t) ((3 + counters.groupSize) * sizeof(unsigned long long));
+    if (read(counters.fds[counters.leader], buffer, sizeof(buffer)) < expected) {
+        return false;
+    }
+    *enabled = buffer[1];
+    *running = buffer[2];
+    for (int slot = 0; slot < counters.groupSize; slot++) {
+        counts[slot] = buffer[3 + slot];
+    }
+    return true;
+}
+
+
+// Wait briefly for the group to get onto the PMU -- one that fits the PMU on paper can still never be scheduled
+// when other events (the NMI watchdog) hold counters, and then every member would read 0
+static bool group_runs() {
+    unsigned long long counts[HwCounterCount], enabled = 0, running = 0;
+    struct timespec start, now;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    do {
+        if (!read_group_counts(counts, &enabled, &running)) {
+            return false;
+        }
+        if (running > 0) {
+            return true;
+        }
+        clock_gettime(CLOCK_MONOTONIC, &now);
+    } while ((unsigned long long) (now.tv_sec - start.tv_sec) * 1000000000ULL + (now.tv_nsec - start.tv_nsec) < HW_GROUP_CHECK_NS);
+    return false;
+}
+
+
+// Open this thread's counters -- one group if the PMU takes it, with any counter that won't join (or stops the group
+// being scheduled) opened on its own, and one the CPU lacks left out without stopping the rest
+bool hw_counters_open() {
+    if (counters.tried) {
+        return counters.usable;
+    }
+    counters.tried = true;
+    counters.leader = -1;
+    counters.groupSize = 0;
+    int lastError = 0;
+    long pageSize = sysconf(_SC_PAGESIZE);
+
+    for (int i = 0; i < HwCounterCount; i++) {
+        counters.pages[i] = NULL;
+        counters.groupSlot[i] = -1;
+        int groupFd = (counters.leader >= 0) ? counters.fds[counters.leader] : -1;
+        counters.fds[i] = open_event(i, groupFd);
+        if (counters.fds[i] < 0 && groupFd >= 0) {
+            counters.fds[i] = open_event(i, -1);
+            groupFd = -1;
+        }
+        if (counters.fds[i] < 0) {
+            lastError = errno;
+            continue;
+        }
+        counters.usable = true;
+        if (counters.leader < 0) {
+            counters.leader = i;
+        }
+        if (groupFd >= 0 || counters.leader == i) {
+            counters.groupSlot[i] = counters.groupSize++;
+        }
+    }
+
+    // Move members out of the group, last first, until it can be scheduled
+    for (int i = HwCounterCount - 1; counters.groupSize > 1 && i > counters.leader && !group_runs(); i--) {
+        if (counters.groupSlot[i] < 0) {
+            continue;
+        }
+        close(counters.fds[i]);
+        counters.groupSlot[i] = -1;
+        counters.groupSize--;
+        counters.fds[i] = open_event(i, -1);
+    }
+
+    // The mapped page lets a counter be read with rdpmc instead of a system call
+    for (int i = 0; i < HwCounterCount; i++) {
+        if (counters.fds[i] >= 0) {
+            void *page = mmap(NULL, pageSize, PROT_READ, MAP_SHARED, counters.fds[i], 0);
+            counters.pages[i] = (page != MAP_FAILED) ? page : NULL;
+        }
+    }
+
+    if (counters.usable) {
+        int standalone = 0;
+        for (int i = 0; i < HwCounterCount; i++) {
+            standalone += (counters.fds[i] >= 0 && counters.groupSlot[i] < 0);
+        }
+        snprintf(statusText, sizeof(statusText), "%s, group of %d, %d on their own", hw_counters_use_rdpmc() ? "rdpmc" : "read()",
+                 counters.groupSize, standalone);
+    } else {
+        snprintf(statusText, sizeof(statusText), "unavailable: %s (check /proc/sys/kernel/perf_event_paranoid)", strerror(lastError));
+    }
+    return counters.usable;
+}
+
+
+// Read one counter with rdpmc through its mapped page -- only while it's on the PMU and has been ever since it was
+// enabled, as then the raw count needs no scaling. False means read() it instead
+static bool rdpmc_counter(int i, unsigned long long *value) {
+#ifdef HW_HAVE_RDPMC
+    struct perf_event_mmap_page *page = counters.pages[i];
+    if (page == NULL) {
+        return false;
+    }
+    unsigned int seq, index;
+    long long count;
+    bool whole;
+    // The page is updated under a sequence lock -- retry if it changed while reading
+    do {
+        seq = page->lock;
+        __asm__ __volatile__("" ::: "memory");
+        index = page->index;
+        count = page->offset;
+        whole = page->time_enabled == page->time_running;
+        if (page->cap_user_rdpmc && index != 0 && whole) {
+            int shift = 64 - page->pmc_width;
+            count += (long long)((unsigned long long) __rdpmc(index - 1) << shift) >> shift;
+        } else {
+            index = 0;
+        }
+        __asm__ __volatile__("" ::: "memory");
+    } while (page->lock != seq);
+    *value = (unsigned long long) count;
+    return index != 0;
+#else
+    (void) i;
+    (void) value;
+    return false;
+#endif
+}
+
+
+// Read every counter in the group -- rdpmc while the group has never been multiplexed, otherwise one read() of the
+// leader with every count scaled by the group's shared enabled/running times
+static void read_group(unsigned long long values[HwCounterCount]) {
+    bool fast = true;
+    for (int i = 0; i < HwCounterCount && fast; i++) {
+        if (counters.groupSlot[i] >= 0) {
+            fast = rdpmc_counter(i, &values[i]);
+        }
+    }
+    if (fast) {
+        return;
+    }
+
+    unsigned long long counts[HwCounterCount], enabled, running;
+    unsigned int mask = 0;
+    for (int i = 0; i < HwCounterCount; i++) {
+        mask |= (counters.groupSlot[i] >= 0) ? 1u << i : 0;
+    }
+    bool valid = read_group_counts(counts, &enabled, &running);
+    for (int i = 0; i < HwCounterCount; i++) {
+        if (counters.groupSlot[i] >= 0) {
+            values[i] = valid ? scale_count(counts[counters.groupSlot[i]], enabled, running, mask) : 0;
+        }
+    }
+}
+
+
+// Read a counter opened on its own -- rdpmc when it needs no scaling, otherwise read() and scale its count
+static unsigned long long read_counter(int i) {
+    unsigned long long value;
+    if (rdpmc_counter(i, &value)) {
+        return value;
+    }
+    unsigned long long buffer[3];
+    if (read(counters.fds[i], buffer, sizeof(buffer)) != sizeof(buffer)) {
+        return 0;
+    }
+    return scale_count(buffer[0], buffer[1], buffer[2], 1u << i);
+}
+
+
+// Read every counter this thread has open -- false if none could be opened
+bool hw_counters_read(unsigned long long values[HwCounterCount]) {
+    if (!counters.tried) {
+        hw_counters_open();
+    }
+    if (!counters.usable) {
+        return false;
+    }
+    read_group(values);
+    for (int i = 0; i < HwCounterCount; i++) {
+        if (counters.groupSlot[i] < 0) {
+            values[i] = (counters.fds[i] >= 0) ? read_counter(i) : 0;
+        }
+    }
+    return true;
+}
+
+
+// Check if a counter opened on this thread
+bool hw_counter_enabled(hwCounter counter) {
+    return counters.usable && counters.fds[counter] >= 0;
+}
+
+
+// Check if this thread's counters are read with rdpmc
+bool hw_counters_use_rdpmc() {
+#ifdef HW_HAVE_RDPMC
+    for (int i = 0; i < HwCounterCount; i++) {
+        if (counters.pages[i] != NULL && counters.pages[i]->cap_user_rdpmc) {
+            return true;
+        }
+    }
+#endif
+    return false;
+}
+
+#else
+// Hardware counters are only read through perf_event_open on Linux
+bool hw_counters_open() {
+    snprintf(statusText, sizeof(statusText), "unavailable: not supported on this platform");
+    return false;
+}
+
+
+bool hw_counters_read(unsigned long long values[HwCounterCount]) {
+    (void) values;
+    return false;
+}
+
+
+bool hw_counter_enabled(hwCounter counter) {
+    (void) counter;
+    return false;
+}
+
+
+bool hw_counters_use_rdpmc() {
+    return false;
+}
+#endif
+
+
+// Check if a counter's counts have been scaled because it wasn't on the PMU the whole time
+bool hw_counter_multiplexed(hwCounter counter) {
+    return (atomic_load_explicit(&multiplexedCounters, memory_order_relaxed) >> counter) & 1;
+}
+
+
+// How the counters are being read, or why they can't be
+const char *hw_counters_status() {
+    return statusText;
+}
\ No newline at end of file
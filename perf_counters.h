@@ -0,0 +1,21 @@
+#ifndef PERF_COUNTERS_H
+#define PERF_COUNTERS_H
+
+// Standard includes
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+
+// Hardware events counted around each timing
+typedef enum {HwCycles, HwInstructions, HwBranches, HwBranchMisses, HwL1dMisses, HwLlcMisses, HwCounterCount} hwCounter;
+
+// Function declarations
+bool hw_counters_open();
+bool hw_counter_enabled(hwCounter counter);
+bool hw_counters_read(unsigned long long values[HwCounterCount]);
+bool hw_counters_use_rdpmc();
+bool hw_counter_multiplexed(hwCounter counter);
+const char *hw_counters_status();
+
+#endif
\ No newline at end of file
@@ -0,0 +1,491 @@
+#define _GNU_SOURCE
+#include "perf_sampler.h"
+#include "alloc_track.h"
+
+#if defined(__linux__)
+    #include <dlfcn.h>
+    #include <elf.h>
+    #include <errno.h>
+    #include <execinfo.h>
+    #include <fcntl.h>
+    #include <link.h>
+    #include <signal.h>
+    #include <stdatomic.h>
+    #include <stdint.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <time.h>
+    #include <ucontext.h>
+    #include <unistd.h>
+#endif
+
+#if defined(__linux__)
+// Samples taken by the signal handler -- slots are claimed with an atomic add so any thread can be interrupted
+static profileSample *samples = NULL;
+static atomic_ullong nextSample = 0;
+static atomic_ullong droppedSamples = 0;
+static int sampleHz = 0;
+static bool sampling = false;
+static timer_t profileTimer;
+static struct sigaction previousAction;
+
+// A function in the executable's symbol table, with the load address added
+typedef struct {
+    uintptr_t start;
+    uintptr_t end;                  // 0 when the symbol has no size -- it then runs to the next symbol
+    const char *name;
+} funcSymbol;
+
+// Executable symbols, sorted by address -- names point into the mapped file
+static funcSymbol *symbols = NULL;
+static int symbolCount = 0;
+static void *exeImage = NULL;
+static size_t exeImageSize = 0;
+
+// Functions seen while symbolising, with their sample counts
+typedef struct {
+    const char *name;
+    unsigned long long self;        // Samples where it was the interrupted function
+    unsigned long long total;       // Samples where it was anywhere on the stack
+    unsigned long long lastSample;  // Stops recursion counting a sample twice in total
+} funcStats;
+
+
+// Instruction the signal interrupted
+static void *context_ip(void *context) {
+    ucontext_t *uc = (ucontext_t*) context;
+#if defined(__x86_64__)
+    return (void*) uc->uc_mcontext.gregs[REG_RIP];
+#elif defined(__i386__)
+    return (void*) uc->uc_mcontext.gregs[REG_EIP];
+#elif defined(__aarch64__)
+    return (void*) uc->uc_mcontext.pc;
+#else
+    (void) uc;
+    return NULL;
+#endif
+}
+
+
+// SIGPROF handler -- copies the interrupted stack into the next free slot, nothing else
+static void sampler_handler(int sig, siginfo_t *info, void *context) {
+    (void) sig;
+    (void) info;
+    int savedErrno = errno;
+    unsigned long long slot = atomic_fetch_add_explicit(&nextSample, 1, memory_order_relaxed);
+    if (slot >= SAMPLER_MAX_SAMPLES) {
+        atomic_fetch_add_explicit(&droppedSamples, 1, memory_order_relaxed);
+        errno = savedErrno;
+        return;
+    }
+    profileSample *sample = &samples[slot];
+    void *ip = context_ip(context);
+
+    // The unwind starts in this handler and passes through the signal frame -- skip to the interrupted instruction
+    void *stack[SAMPLER_MAX_DEPTH + 4];
+    int frames = backtrace(stack, SAMPLER_MAX_DEPTH + 4);
+    int first = 0;
+    while (first < frames && stack[first] != ip) {
+        first++;
+    }
+    int depth = 0;
+    if (first == frames) {
+        sample->frames[depth++] = ip;
+        first = (frames > 2) ? 3 : frames;
+    }
+    while (first < frames && depth < SAMPLER_MAX_DEPTH) {
+        sample->frames[depth++] = stack[first++];
+    }
+    sample->depth = depth;
+    errno = savedErrno;
+}
+
+
+// Start sampling the whole process hz times per second of CPU time -- false if it is already running or can't be set up
+bool sampler_start(int hz) {
+    if (sampling || hz <= 0) {
+        return false;
+    }
+    if (samples == NULL) {
+        samples = tracked_calloc(AllocTelemetry, SAMPLER_MAX_SAMPLES, sizeof(profileSample));
+        if (!samples) {
+            printf("Error Allocating Memory!\n");
+            exit(-1);
+        }
+    }
+    atomic_store(&nextSample, 0);
+    atomic_store(&droppedSamples, 0);
+
+    // The first backtrace loads the unwinder, which isn't safe inside a signal handler
+    void *warmup[4];
+    backtrace(warmup, 4);
+
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_sigaction = sampler_handler;
+    action.sa_flags = SA_SIGINFO | SA_RESTART;
+    sigemptyset(&action.sa_mask);
+    if (sigaction(SIGPROF, &action, &previousAction) != 0) {
+        perror("Error installing SIGPROF handler");
+        return false;
+    }
+
+    // CPU time of the whole process, so idle waits aren't sampled
+    struct sigevent event;
+    memset(&event, 0, sizeof(event));
+    event.sigev_notify = SIGEV_SIGNAL;
+    event.sigev_signo = SIGPROF;
+    if (timer_create(CLOCK_PROCESS_CPUTIME_ID, &event, &profileTimer) != 0) {
+        perror("Error creating profiling timer");
+        sigaction(SIGPROF, &previousAction, NULL);
+        return false;
+    }
+    long long intervalNs = 1000000000LL / hz;
+    struct itimerspec spec;
+    spec.it_interval.tv_sec = intervalNs / 1000000000LL;
+    spec.it_interval.tv_nsec = intervalNs % 1000000000LL;
+    spec.it_value = spec.it_interval;
+    if (timer_settime(profileTimer, 0, &spec, NULL) != 0) {
+        perror("Error starting profiling timer");
+        timer_delete(profileTimer);
+        sigaction(SIGPROF, &previousAction, NULL);
+        return false;
+    }
+    sampleHz = hz;
+    sampling = true;
+    return true;
+}
+
+
+// Stop the timer and put back the previous SIGPROF handler
+void sampler_stop() {
+    if (!sampling) {
+        return;
+    }
+    timer_delete(profileTimer);
+    // A SIGPROF raised before the timer went may still be pending -- ignoring the signal discards it, so it can't reach
+    // the previous handler (by default SIGPROF terminates the process)
+    struct sigaction ignore;
+    memset(&ignore, 0, sizeof(ignore));
+    ignore.sa_handler = SIG_IGN;
+    sigemptyset(&ignore.sa_mask);
+    sigaction(SIGPROF, &ignore, NULL);
+    sigaction(SIGPROF, &previousAction, NULL);
+    sampling = false;
+}
+
+
+// Samples held in the buffer
+unsigned long long sampler_sample_count() {
+    unsigned long long taken = atomic_load(&nextSample);
+    return (taken < SAMPLER_MAX_SAMPLES) ? taken : SAMPLER_MAX_SAMPLES;
+}
+
+
+// Samples lost because the buffer was full
+unsigned long long sampler_dropped() {
+    return atomic_load(&droppedSamples);
+}
+
+
+// Load address of the executable -- the first object dl_iterate_phdr reports
+static int main_object_bias(struct dl_phdr_info *info, size_t size, void *data) {
+    (void) size;
+    *(uintptr_t*) data = (uintptr_t) info->dlpi_addr;
+    return 1;
+}
+
+
+// Sort helper for symbols by address
+static int compare_symbols(const void *a, const void *b) {
+    uintptr_t x = ((const funcSymbol*) a)->start, y = ((const funcSymbol*) b)->start;
+    return (x > y) - (x < y);
+}
+
+
+// Read the function symbols of the running executable -- static functions are only in .symtab, not the dynamic table
+static void load_symbols() {
+    int fd = open("/proc/self/exe", O_RDONLY);
+    if (fd < 0) {
+        return;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t) st.st_size < sizeof(ElfW(Ehdr))) {
+        close(fd);
+        return;
+    }
+    exeImageSize = (size_t) st.st_size;
+    exeImage = mmap(NULL, exeImageSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (exeImage == MAP_FAILED) {
+        exeImage = NULL;
+        return;
+    }
+    const char *base = (const char*) exeImage;
+    const ElfW(Ehdr) *header = (const ElfW(Ehdr)*) base;
+    if (memcmp(header->e_ident, ELFMAG, SELFMAG) != 0 || header->e_shoff == 0 ||
+        header->e_shoff + (size_t) header->e_shnum * sizeof(ElfW(Shdr)) > exeImageSize) {
+        return;
+    }
+    const ElfW(Shdr) *sections = (const ElfW(Shdr)*) (base + header->e_shoff);
+
+    // A stripped executable only has the dynamic symbol table
+    const ElfW(Shdr) *table = NULL;
+    for (int i = 0; i < header->e_shnum && table == NULL; i++) {
+        if (sections[i].sh_type == SHT_SYMTAB) {
+            table = &sections[i];
+        }
+    }
+    for (int i = 0; i < header->e_shnum && table == NULL; i++) {
+        if (sections[i].sh_type == SHT_DYNSYM) {
+            table = &sections[i];
+        }
+    }
+    if (table == NULL || table->sh_link >= header->e_shnum || table->sh_offset + table->sh_size > exeImageSize) {
+        return;
+    }
+    const ElfW(Shdr) *strings = &sections[table->sh_link];
+    const ElfW(Sym) *entries = (const ElfW(Sym)*) (base + table->sh_offset);
+    size_t entryCount = table->sh_size / sizeof(ElfW(Sym));
+
+    uintptr_t bias = 0;
+    dl_iterate_phdr(main_object_bias, &bias);
+
+    symbols = malloc(sizeof(funcSymbol) * (entryCount + 1));
+    if (!symbols) {
+        printf("Error Allocating Memory!\n");
+        exit(-1);
+    }
+    for (size_t i = 0; i < entryCount; i++) {
+        if (ELF64_ST_TYPE(entries[i].st_info) != STT_FUNC || entries[i].st_value == 0 || entries[i].st_name >= strings->sh_size) {
+            continue;
+        }
+        uintptr_t start = bias + (uintptr_t) entries[i].st_value;
+        uintptr_t end = (entries[i].st_size > 0) ? start + (uintptr_t) entries[i].st_size : 0;
+        symbols[symbolCount++] = (funcSymbol){start, end, base + strings->sh_offset + entries[i].st_name};
+    }
+    qsort(symbols, symbolCount, sizeof(funcSymbol), compare_symbols);
+}
+
+
+// Release the executable's symbols
+static void free_symbols() {
+    free(symbols);
+    symbols = NULL;
+    symbolCount = 0;
+    if (exeImage != NULL) {
+        munmap(exeImage, exeImageSize);
+        exeImage = NULL;
+    }
+}
+
+
+// Name of the function containing an address -- executable symbols first, then the shared library's exports
+static const char *symbolise(uintptr_t address) {
+    int low = 0, high = symbolCount - 1, found = -1;
+    while (low <= high) {
+        int mid = (low + high) / 2;
+        if (symbols[mid].start <= address) {
+            found = mid;
+            low = mid + 1;
+        } else {
+            high = mid - 1;
+        }
+    }
+    if (found >= 0 && (symbols[found].end == 0 ? found + 1 < symbolCount : address < symbols[found].end)) {
+        return symbols[found].name;
+    }
+    Dl_info info;
+    if (dladdr((void*) address, &info) && info.dli_sname != NULL) {
+        return info.dli_sname;
+    }
+    if (dladdr((void*) address, &info) && info.dli_fname != NULL) {
+        const char *slash = strrchr(info.dli_fname, '/');
+        return (slash != NULL) ? slash + 1 : info.dli_fname;
+    }
+    return "[unknown]";
+}
+
+
+// Find (or add) a function by name, returning its index -- names come from symbol tables, so the pointer identifies them
+static int function_index(funcStats *functions, int *functionCount, int capacity, int *slots, int slotMask, const char *name) {
+    unsigned int slot = (unsigned int) (((uintptr_t) name >> 3) * 2654435761u) & slotMask;
+    while (slots[slot] >= 0) {
+        if (functions[slots[slot]].name == name) {
+            return slots[slot];
+        }
+        slot = (slot + 1) & slotMask;
+    }
+    // Out of room -- the rest share the last entry
+    if (*functionCount == capacity) {
+        functions[capacity - 1].name = "[other]";
+        return capacity - 1;
+    }
+    functions[*functionCount] = (funcStats){name, 0, 0, 0};
+    slots[slot] = *functionCount;
+    return (*functionCount)++;
+}
+
+
+// Stacks of function indices, compared root first so identical stacks sort next to each other
+static int *stackIds = NULL;
+static int *stackDepths = NULL;
+
+static int compare_stacks(const void *a, const void *b) {
+    int x = *(const int*) a, y = *(const int*) b;
+    int dx = stackDepths[x], dy = stackDepths[y];
+    for (int i = 1; i <= dx && i <= dy; i++) {
+        int fx = stackIds[x * SAMPLER_MAX_DEPTH + dx - i], fy = stackIds[y * SAMPLER_MAX_DEPTH + dy - i];
+        if (fx != fy) {
+            return (fx > fy) - (fx < fy);
+        }
+    }
+    return (dx > dy) - (dx < dy);
+}
+
+
+// Sort helper for the histogram, most self samples first
+static int compare_functions(const void *a, const void *b) {
+    const funcStats *x = (const funcStats*) a, *y = (const funcStats*) b;
+    if (x->self != y->self) {
+        return (x->self < y->self) - (x->self > y->self);
+    }
+    return (x->total < y->total) - (x->total > y->total);
+}
+
+
+// Release the sample buffer -- the next sampler_start allocates a fresh one
+static void free_samples() {
+    if (samples != NULL) {
+        tracked_free(AllocTelemetry, samples, sizeof(profileSample) * SAMPLER_MAX_SAMPLES);
+        samples = NULL;
+    }
+    atomic_store(&nextSample, 0);
+}
+
+
+// Symbolise the samples, print a per-function histogram and write folded stacks (if a filename is given), returning 0
+// on success. The samples are freed once reported
+int sampler_report(const char *foldedFilename) {
+    sampler_stop();
+    int count = (int) sampler_sample_count();
+    printf("\n=== SAMPLING PROFILE ===\n");
+    printf("Samples: %d at %d Hz of CPU time (%llu dropped -- buffer full)\n", count, sampleHz, sampler_dropped());
+    if (count == 0) {
+        free_samples();
+        return 0;
+    }
+
+    load_symbols();
+    // Room for every executable function plus those met in shared libraries -- the slot table is kept at most half full
+    int capacity = symbolCount + SAMPLER_LIBRARY_FUNCTIONS;
+    int slotCount = 1;
+    while (slotCount < capacity * 2) {
+        slotCount *= 2;
+    }
+    funcStats *functions = malloc(sizeof(funcStats) * capacity);
+    int *slots = malloc(sizeof(int) * slotCount);
+    stackIds = malloc(sizeof(int) * (size_t) count * SAMPLER_MAX_DEPTH);
+    stackDepths = malloc(sizeof(int) * count);
+    int *order = malloc(sizeof(int) * count);
+    if (!functions || !slots || !stackIds || !stackDepths || !order) {
+        printf("Error Allocating Memory!\n");
+        exit(-1);
+    }
+    memset(slots, -1, sizeof(int) * slotCount);
+    int functionCount = 0;
+
+    for (int i = 0; i < count; i++) {
+        profileSample *sample = &samples[i];
+        stackDepths[i] = sample->depth;
+        order[i] = i;
+        for (int f = 0; f < sample->depth; f++) {
+            // Caller frames hold return addresses -- step back into the call instruction
+            uintptr_t address = (uintptr_t) sample->frames[f] - (f > 0 ? 1 : 0);
+            int index = function_index(functions, &functionCount, capacity, slots, slotCount - 1, symbolise(address));
+            stackIds[i * SAMPLER_MAX_DEPTH + f] = index;
+            if (f == 0) {
+                functions[index].self++;
+            }
+            if (functions[index].lastSample != (unsigned long long) i + 1) {
+                functions[index].total++;
+                functions[index].lastSample = (unsigned long long) i + 1;
+            }
+        }
+    }
+
+    // Folded stacks, root first, one line per distinct stack -- for flamegraph.pl or speedscope
+    int result = 0;
+    if (foldedFilename != NULL) {
+        FILE *folded = fopen(foldedFilename, "w");
+        if (!folded) {
+            perror("Error opening folded stack file");
+            result = 1;
+        } else {
+            qsort(order, count, sizeof(int), compare_stacks);
+            int runStart = 0;
+            for (int i = 1; i <= count; i++) {
+                if (i < count && compare_stacks(&order[runStart], &order[i]) == 0) {
+                    continue;
+                }
+                int s = order[runStart];
+                for (int f = stackDepths[s] - 1; f >= 0; f--) {
+                    fprintf(folded, "%s%s", functions[stackIds[s * SAMPLER_MAX_DEPTH + f]].name, f > 0 ? ";" : "");
+                }
+                fprintf(folded, " %d\n", i - runStart);
+                runStart = i;
+            }
+            fclose(folded);
+            printf("Folded stacks written to %s\n", foldedFilename);
+        }
+    }
+
+    qsort(functions, functionCount, sizeof(funcStats), compare_functions);
+    printf("%-40s %10s %8s %10s %8s\n", "Function", "Self", "Self%", "Total", "Total%");
+    printf("------------------------------------------------------------------------------\n");
+    for (int i = 0; i < functionCount && i < SAMPLER_REPORT_FUNCTIONS && functions[i].total > 0; i++) {
+        printf("%-40.40s %10llu %7.2f%% %10llu %7.2f%%\n", functions[i].name, functions[i].self, 100.0 * functions[i].self / count,
+               functions[i].total, 100.0 * functions[i].total / count);
+    }
+    printf("\n");
+
+    free(functions);
+    free(slots);
+    free(stackIds);
+    free(stackDepths);
+    free(order);
+    stackIds = NULL;
+    stackDepths = NULL;
+    free_symbols();
+    free_samples();
+    return result;
+}
+
+#else
+// The sampling profiler needs SIGPROF and POSIX timers
+bool sampler_start(int hz) {
+    (void) hz;
+    printf("Sampling profiler not supported on this platform\n");
+    return false;
+}
+
+
+void sampler_stop() {
+}
+
+
+unsigned long long sampler_sample_count() {
+    return 0;
+}
+
+
+unsigned long long sampler_dropped() {
+    return 0;
+}
+
+
+int sampler_report(const char *foldedFilename) {
+    (void) foldedFilename;
+    return 0;
+}
+#endif
\ No newline at end of file
@@ -0,0 +1,29 @@
+#ifndef PERF_SAMPLER_H
+#define PERF_SAMPLER_H
+
+// Standard includes
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+
+// Define the sample buffer -- filled from the signal handler, so it is allocated up front
+#define SAMPLER_MAX_SAMPLES 65536
+#define SAMPLER_MAX_DEPTH 16            // Frames kept per sample, the interrupted function first
+#define SAMPLER_REPORT_FUNCTIONS 25     // Functions listed in the printed histogram
+#define SAMPLER_LIBRARY_FUNCTIONS 4096  // Distinct shared library functions the report can name
+
+// One sample -- the interrupted instruction followed by the return addresses of its callers
+typedef struct {
+    int depth;
+    void *frames[SAMPLER_MAX_DEPTH];
+} profileSample;
+
+// Function declarations
+bool sampler_start(int hz);
+void sampler_stop();
+unsigned long long sampler_sample_count();
+unsigned long long sampler_dropped();
+int sampler_report(const char *foldedFilename);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,284 @@
+#include "perf_trace.h"
+#include "benchmark.h"
+#include "order_book.h"
+#include "alloc_track.h"
+#include <pthread.h>
+#include <stdatomic.h>
+
+// Single producer (the timing thread) / single consumer (the flusher) ring of events
+typedef struct {
+    traceEvent events[TRACE_RING_EVENTS];
+    atomic_ullong head;                 // Next event the flusher takes -- only the flusher moves it
+    char headPadding[64];
+    atomic_ullong tail;                 // Next free slot -- only the owning thread moves it
+    char tailPadding[64];
+    atomic_ullong dropped;
+    int thread;
+} traceRing;
+
+// Rings of every thread that has recorded an event -- kept for the life of the process
+static traceRing *rings[TRACE_MAX_THREADS];
+static atomic_int ringCount = 0;
+static pthread_mutex_t ringLock = PTHREAD_MUTEX_INITIALIZER;
+static atomic_ullong unregisteredDropped = 0;
+
+// This thread's ring
+static SIM_LOCAL traceRing *threadRing = NULL;
+static SIM_LOCAL bool threadRingFailed = false;
+
+// The trace being written and its flusher thread
+static FILE *traceFile = NULL;
+static pthread_t flusherThread;
+static atomic_bool tracing = false;
+static atomic_bool flusherStop = false;
+static traceEvent writeBuffer[TRACE_WRITE_EVENTS];
+static int writeCount = 0;
+
+
+// Give this thread a ring the first time it records -- false if there is no room for another thread
+static bool claim_thread_ring() {
+    if (threadRingFailed) {
+        return false;
+    }
+    pthread_mutex_lock(&ringLock);
+    int count = atomic_load(&ringCount);
+    if (count < TRACE_MAX_THREADS) {
+        threadRing = tracked_calloc(AllocTelemetry, 1, sizeof(traceRing));
+    }
+    if (threadRing != NULL) {
+        threadRing->thread = count;
+        rings[count] = threadRing;
+        atomic_store_explicit(&ringCount, count + 1, memory_order_release);
+    } else {
+        threadRingFailed = true;
+    }
+    pthread_mutex_unlock(&ringLock);
+    return threadRing != NULL;
+}
+
+
+// Add an event to this thread's ring -- never blocks, the event is counted as dropped if the ring is full
+void trace_record(traceEventKind kind, int metric, unsigned long long ticks, unsigned long long duration, unsigned long long value) {
+    if (threadRing == NULL && !claim_thread_ring()) {
+        atomic_fetch_add_explicit(&unregisteredDropped, 1, memory_order_relaxed);
+        return;
+    }
+    traceRing *ring = threadRing;
+    unsigned long long tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    unsigned long long head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    if (tail - head >= TRACE_RING_EVENTS) {
+        atomic_fetch_add_explicit(&ring->dropped, 1, memory_order_relaxed);
+        return;
+    }
+    ring->events[tail & (TRACE_RING_EVENTS - 1)] = (traceEvent){ticks, duration, value, metric, (uint16_t) kind, (uint16_t) ring->thread};
+    atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+}
+
+
+// Write out the flusher's buffer in one go
+static void write_buffer() {
+    if (writeCount > 0) {
+        fwrite(writeBuffer, sizeof(traceEvent), writeCount, traceFile);
+        writeCount = 0;
+    }
+}
+
+
+// Add an event to the flusher's buffer, writing it out once full
+static void buffer_event(const traceEvent *event) {
+    writeBuffer[writeCount++] = *event;
+    if (writeCount == TRACE_WRITE_EVENTS) {
+        write_buffer();
+    }
+}
+
+
+// Move everything waiting in the rings into the write buffer, returning how many events moved
+static unsigned long long drain_rings() {
+    unsigned long long moved = 0;
+    int count = atomic_load_explicit(&ringCount, memory_order_acquire);
+    for (int i = 0; i < count; i++) {
+        traceRing *ring = rings[i];
+        unsigned long long head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+        unsigned long long tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+        for (unsigned long long next = head; next < tail; next++) {
+            buffer_event(&ring->events[next & (TRACE_RING_EVENTS - 1)]);
+        }
+        atomic_store_explicit(&ring->head, tail, memory_order_release);
+        moved += tail - head;
+    }
+    return moved;
+}
+
+
+// Background thread -- drains the rings, samples memory now and then, and sleeps when idle
+static void *trace_flusher(void *arg) {
+    (void) arg;
+    double lastMemorySample = 0;
+    while (true) {
+        bool stopping = atomic_load(&flusherStop);
+        unsigned long long moved = drain_rings();
+
+        double now = get_time_ms();
+        if (now - lastMemorySample >= TRACE_MEMORY_INTERVAL_MS) {
+            traceEvent sample = {perf_read_ticks(), 0, alloc_live_bytes() / 1024, -1, TraceMemory, 0};
+            buffer_event(&sample);
+            lastMemorySample = now;
+        }
+        // The stop flag was seen before draining, so everything recorded before trace_stop is out
+        if (stopping) {
+            break;
+        }
+        if (moved == 0) {
+#ifdef _WIN32
+            Sleep(1);
+#else
+            usleep(1000);
+#endif
+        }
+    }
+    write_buffer();
+    return NULL;
+}
+
+
+// Open a trace file and start the flusher thread
+bool trace_start(const char *filename, double nsPerTick, unsigned long long startTicks) {
+    if (atomic_load(&tracing)) {
+        return false;
+    }
+    traceFile = fopen(filename, "wb");
+    if (!traceFile) {
+        perror("Error opening trace file");
+        return false;
+    }
+    traceFileHeader header = {TRACE_MAGIC, 1, nsPerTick, startTicks};
+    fwrite(&header, sizeof(header), 1, traceFile);
+
+    // Rings from an earlier trace are reused empty
+    int count = atomic_load(&ringCount);
+    for (int i = 0; i < count; i++) {
+        atomic_store(&rings[i]->head, 0);
+        atomic_store(&rings[i]->tail, 0);
+        atomic_store(&rings[i]->dropped, 0);
+    }
+    atomic_store(&unregisteredDropped, 0);
+    writeCount = 0;
+
+    atomic_store(&flusherStop, false);
+    if (pthread_create(&flusherThread, NULL, trace_flusher, NULL) != 0) {
+        fclose(traceFile);
+        traceFile = NULL;
+        return false;
+    }
+    atomic_store(&tracing, true);
+    return true;
+}
+
+
+// Check if events are being traced
+bool trace_active() {
+    return atomic_load_explicit(&tracing, memory_order_relaxed);
+}
+
+
+// Stop the flusher once it has written every event, then finish the file with the metric names
+void trace_stop(const char *const *metricNames, int metricCount) {
+    if (!atomic_load(&tracing)) {
+        return;
+    }
+    atomic_store(&tracing, false);
+    atomic_store(&flusherStop, true);
+    pthread_join(flusherThread, NULL);
+
+    char name[TRACE_NAME_LENGTH];
+    for (int i = 0; i < metricCount; i++) {
+        memset(name, 0, sizeof(name));
+        strncpy(name, metricNames[i], sizeof(name) - 1);
+        fwrite(name, sizeof(name), 1, traceFile);
+    }
+    traceFileTrailer trailer = {trace_dropped(), (uint32_t) metricCount, TRACE_MAGIC};
+    fwrite(&trailer, sizeof(trailer), 1, traceFile);
+    fclose(traceFile);
+    traceFile = NULL;
+}
+
+
+// Events lost because a ring was full (or a thread couldn't get one) in the current or last trace
+unsigned long long trace_dropped() {
+    unsigned long long dropped = atomic_load(&unregisteredDropped);
+    int count = atomic_load(&ringCount);
+    for (int i = 0; i < count; i++) {
+        dropped += atomic_load_explicit(&rings[i]->dropped, memory_order_relaxed);
+    }
+    return dropped;
+}
+
+
+// Convert a trace file to the perf log CSV layout (timestamp,operation,duration_ms,memory_kb), returning 0 on success
+int trace_to_csv(const char *traceFilename, const char *csvFilename) {
+    traceFileHeader header;
+    traceFileTrailer trailer;
+    FILE *trace = fopen(traceFilename, "rb");
+    if (!trace) {
+        perror("Error opening trace file");
+        return 1;
+    }
+    // The names and trailer sit at the end of the file, after the events
+    if (fread(&header, sizeof(header), 1, trace) != 1 || header.magic != TRACE_MAGIC ||
+        fseek(trace, -(long) sizeof(trailer), SEEK_END) != 0 || fread(&trailer, sizeof(trailer), 1, trace) != 1 ||
+        trailer.magic != TRACE_MAGIC) {
+        printf("Not a complete trace file: %s\n", traceFilename);
+        fclose(trace);
+        return 1;
+    }
+    long namesStart = ftell(trace) - (long) sizeof(trailer) - (long) trailer.metricCount * TRACE_NAME_LENGTH;
+    char (*names)[TRACE_NAME_LENGTH] = malloc((size_t) (trailer.metricCount + 1) * TRACE_NAME_LENGTH);
+    if (!names) {
+        printf("Error Allocating Memory!\n");
+        exit(-1);
+    }
+    fseek(trace, namesStart, SEEK_SET);
+    if (fread(names, TRACE_NAME_LENGTH, trailer.metricCount, trace) != trailer.metricCount) {
+        printf("Not a complete trace file: %s\n", traceFilename);
+        free(names);
+        fclose(trace);
+        return 1;
+    }
+
+    FILE *csv = fopen(csvFilename, "w");
+    if (!csv) {
+        perror("Error opening CSV file");
+        free(names);
+        fclose(trace);
+        return 1;
+    }
+    fprintf(csv, "timestamp,operation,duration_ms,memory_kb\n");
+
+    // Each timing is given the most recent memory sample before it
+    unsigned long long memoryKb = 0;
+    long long converted = 0;
+    long eventCount = (namesStart - (long) sizeof(header)) / (long) sizeof(traceEvent);
+    traceEvent event;
+    fseek(trace, sizeof(header), SEEK_SET);
+    for (long i = 0; i < eventCount && fread(&event, sizeof(event), 1, trace) == 1; i++) {
+        double timestamp = (double) (long long) (event.ticks - header.startTicks) * header.nsPerTick / 1000000.0;
+        bool named = event.metric >= 0 && (uint32_t) event.metric < trailer.metricCount;
+        if (event.kind == TraceMemory) {
+            memoryKb = event.value;
+            if (named) {
+                fprintf(csv, "%.3f,%s,0,%llu\n", timestamp, names[event.metric], memoryKb);
+                converted++;
+            }
+        } else if (named) {
+            fprintf(csv, "%.3f,%s,%.4f,%llu\n", timestamp, names[event.metric], event.duration * header.nsPerTick / 1000000.0, memoryKb);
+            converted++;
+        }
+    }
+    printf("Converted %lld trace events to %s (%llu dropped while tracing)\n", converted, csvFilename, (unsigned long long) trailer.dropped);
+
+    fclose(csv);
+    fclose(trace);
+    free(names);
+    return 0;
+}
\ No newline at end of file
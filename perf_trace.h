@@ -0,0 +1,55 @@
+#ifndef PERF_TRACE_H
+#define PERF_TRACE_H
+
+// Standard includes
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+// Define the trace buffering -- per-thread ring size (a power of two) and events per write to disk
+#define TRACE_RING_EVENTS 16384
+#define TRACE_MAX_THREADS 64
+#define TRACE_WRITE_EVENTS 32768
+#define TRACE_MEMORY_INTERVAL_MS 50     // How often the flusher samples memory use
+#define TRACE_MAGIC 0x43525450          // "PTRC"
+#define TRACE_NAME_LENGTH 64
+
+// Kinds of event in a trace
+typedef enum {TraceTiming, TraceMemory} traceEventKind;
+
+// One trace event -- 32 bytes on disk
+typedef struct {
+    uint64_t ticks;             // Perf clock reading when the event happened
+    uint64_t duration;          // Timing length in perf clock ticks
+    uint64_t value;             // Memory use in KB for TraceMemory events
+    int32_t metric;             // Perf metric handle, -1 for the flusher's own memory samples
+    uint16_t kind;
+    uint16_t thread;
+} traceEvent;
+
+// Start of a trace file -- then events, metric names, and a traceFileTrailer
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    double nsPerTick;
+    uint64_t startTicks;
+} traceFileHeader;
+
+// End of a trace file
+typedef struct {
+    uint64_t dropped;           // Events lost because a thread's ring was full
+    uint32_t metricCount;       // Number of TRACE_NAME_LENGTH byte names before the trailer
+    uint32_t magic;
+} traceFileTrailer;
+
+// Function declarations
+bool trace_start(const char *filename, double nsPerTick, unsigned long long startTicks);
+bool trace_active();
+void trace_record(traceEventKind kind, int metric, unsigned long long ticks, unsigned long long duration, unsigned long long value);
+void trace_stop(const char *const *metricNames, int metricCount);
+unsigned long long trace_dropped();
+int trace_to_csv(const char *traceFilename, const char *csvFilename);
+
+#endif
\ No newline at end of file
@@ -13,4 +13,194 @@ void update_portfolio(tradeType tradeDirection, double priceUsed, double volumeC
         // Simply remove the volume of base currency we sold
         user->baseCurrencyBalance -= volumeChange; 
     }
+    // Keep the risk gate's position total in step with the balances
+    risk_on_fill(&user->risk, tradeDirection, volumeChange);
+}
+
+
+//! Multi-Currency Portfolio -- the pair graph is only walked again when its shape changes, and a top of book or
+//! balance change only reprices the currencies it affects
+// Start an empty portfolio
+void portfolio_init(multiPortfolio *portfolio) {
+    memset(portfolio, 0, sizeof(multiPortfolio));
+    portfolio->ratesDirty = true;
+    portfolio->valueDirty = true;
+}
+
+
+// Add a currency (or find it if it's already there), returning its index or -1 if full
+int portfolio_add_currency(multiPortfolio *portfolio, const char *code) {
+    for (int i = 0; i < portfolio->currencyCount; i++) {
+        if (strncmp(portfolio->codes[i], code, 3) == 0) {
+            return i;
+        }
+    }
+    if (portfolio->currencyCount >= MAX_CURRENCIES) {
+        printf("Reached Maximum Number of Currencies!\n");
+        return -1;
+    }
+    int index = portfolio->currencyCount++;
+    strncpy(portfolio->codes[index], code, 3);
+    portfolio->codes[index][3] = '\0';
+    portfolio->ratesDirty = true;
+    return index;
+}
+
+
+// Add a pair whose book links two currencies, returning its index or -1 if full
+int portfolio_add_pair(multiPortfolio *portfolio, int base, int quote) {
+    if (portfolio->pairCount >= MAX_CURRENCY_PAIRS) {
+        printf("Reached Maximum Number of Currency Pairs!\n");
+        return -1;
+    }
+    portfolio->pairs[portfolio->pairCount] = (currencyPair){base, quote, 0.0, 0.0};
+    portfolio->ratesDirty = true;
+    return portfolio->pairCount++;
+}
+
+
+// Choose the currency the portfolio is valued in
+void portfolio_set_valuation_currency(multiPortfolio *portfolio, int currency) {
+    if (portfolio->valuationCurrency != currency) {
+        portfolio->valuationCurrency = currency;
+        portfolio->ratesDirty = true;
+    }
+}
+
+
+// Work out a currency's rate from the pair that priced it in the last walk
+static double rate_through_pair(multiPortfolio *portfolio, int currency) {
+    currencyPair *pair = &portfolio->pairs[portfolio->parentPair[currency]];
+    if (pair->base == currency) {
+        return pair->bid * portfolio->rates[pair->quote];
+    }
+    return portfolio->rates[pair->base] / pair->ask;
+}
+
+
+// Reprice a currency and every currency priced through it, moving the cached value by each one's change
+static void reprice_subtree(multiPortfolio *portfolio, int root) {
+    int stack[MAX_CURRENCIES];
+    int top = 0;
+    stack[top++] = root;
+    while (top > 0) {
+        int currency = stack[--top];
+        double oldRate = portfolio->rates[currency];
+        double newRate = rate_through_pair(portfolio, currency);
+        portfolio->rates[currency] = newRate;
+        if (!portfolio->valueDirty) {
+            portfolio->cachedValue += portfolio->balances[currency] * (newRate - oldRate);
+        }
+        // Currencies whose pricing pair leads back to this one
+        for (int i = 0; i < portfolio->currencyCount; i++) {
+            int parent = portfolio->parentPair[i];
+            if (parent >= 0 && i != currency &&
+                (portfolio->pairs[parent].base == currency || portfolio->pairs[parent].quote == currency)) {
+                stack[top++] = i;
+            }
+        }
+    }
+}
+
+
+// Feed a pair's top of book -- only the currencies priced through this pair are repriced, so a pair that prices
+// nothing costs nothing. A side appearing or disappearing can change which paths exist, so that walks the graph again
+void portfolio_update_book(multiPortfolio *portfolio, int pair, double bid, double ask) {
+    currencyPair *book = &portfolio->pairs[pair];
+    if (book->bid == bid && book->ask == ask) {
+        return;
+    }
+    bool shapeChanged = (book->bid > 0) != (bid > 0) || (book->ask > 0) != (ask > 0);
+    book->bid = bid;
+    book->ask = ask;
+    if (portfolio->ratesDirty) {
+        return;
+    }
+    if (shapeChanged) {
+        portfolio->ratesDirty = true;
+    } else if (portfolio->pairPrices[pair] >= 0) {
+        reprice_subtree(portfolio, portfolio->pairPrices[pair]);
+    }
+}
+
+
+// Set a currency's balance -- the cached value moves by the change times the currency's rate
+void portfolio_set_balance(multiPortfolio *portfolio, int currency, double balance) {
+    if (portfolio->balances[currency] != balance) {
+        if (!portfolio->valueDirty) {
+            portfolio->cachedValue += (balance - portfolio->balances[currency]) * portfolio->rates[currency];
+        }
+        portfolio->balances[currency] = balance;
+    }
+}
+
+
+// Copy a single pair account's balances into the portfolio
+void portfolio_sync_account(multiPortfolio *portfolio, int base, int quote, const userAccount *account) {
+    portfolio_set_balance(portfolio, base, account->baseCurrencyBalance);
+    portfolio_set_balance(portfolio, quote, account->quoteCurrencyBalance);
+}
+
+
+// Walk the pair graph out from the valuation currency, pricing each currency by the first path that reaches it and
+// remembering that path's last pair so book updates can reprice just what depends on them
+static void recompute_rates(multiPortfolio *portfolio) {
+    int queue[MAX_CURRENCIES];
+    int head = 0, tail = 0;
+    memset(portfolio->rates, 0, sizeof(portfolio->rates));
+    memset(portfolio->parentPair, -1, sizeof(portfolio->parentPair));
+    memset(portfolio->pairPrices, -1, sizeof(portfolio->pairPrices));
+    portfolio->valueDirty = true;
+    if (portfolio->currencyCount == 0) {
+        return;
+    }
+    portfolio->rates[portfolio->valuationCurrency] = 1.0;
+    queue[tail++] = portfolio->valuationCurrency;
+
+    while (head < tail) {
+        int known = queue[head++];
+        for (int i = 0; i < portfolio->pairCount; i++) {
+            currencyPair *pair = &portfolio->pairs[i];
+            // Base is worth what selling it at the bid gives, quote what buying base at the ask costs
+            if (pair->quote == known && portfolio->rates[pair->base] == 0 && pair->bid > 0) {
+                portfolio->rates[pair->base] = pair->bid * portfolio->rates[known];
+                portfolio->parentPair[pair->base] = i;
+                portfolio->pairPrices[i] = pair->base;
+                queue[tail++] = pair->base;
+            } else if (pair->base == known && portfolio->rates[pair->quote] == 0 && pair->ask > 0) {
+                portfolio->rates[pair->quote] = portfolio->rates[known] / pair->ask;
+                portfolio->parentPair[pair->quote] = i;
+                portfolio->pairPrices[i] = pair->quote;
+                queue[tail++] = pair->quote;
+            }
+        }
+    }
+    portfolio->ratesDirty = false;
+}
+
+
+// Value of one unit of a currency in the valuation currency
+double portfolio_rate(multiPortfolio *portfolio, int currency) {
+    if (portfolio->ratesDirty) {
+        recompute_rates(portfolio);
+    }
+    return portfolio->rates[currency];
+}
+
+
+// Total value in the valuation currency -- only re-summed after the graph has been walked again, otherwise kept up
+// to date by the book and balance updates
+double portfolio_value(multiPortfolio *portfolio) {
+    if (portfolio->ratesDirty) {
+        recompute_rates(portfolio);
+    }
+    if (portfolio->valueDirty) {
+        double total = 0.0;
+        for (int i = 0; i < portfolio->currencyCount; i++) {
+            total += portfolio->balances[i] * portfolio->rates[i];
+        }
+        portfolio->cachedValue = total;
+        portfolio->valueDirty = false;
+    }
+    return portfolio->cachedValue;
 }
\ No newline at end of file
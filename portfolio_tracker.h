@@ -9,14 +9,53 @@
 
 // Inlcudes from other project headers
 #include "order_book.h"
+#include "risk.h"
 
 // Struct to hold user balances
 typedef struct {
     double baseCurrencyBalance;
     double quoteCurrencyBalance;
+    riskTotals risk;            // Running totals for the pre-trade risk checks
 } userAccount;
 
+// Define the most currencies and pairs a multi-currency portfolio can track
+#define MAX_CURRENCIES 16
+#define MAX_CURRENCY_PAIRS 32
+
+// Top of book for one traded pair -- an edge in the conversion graph
+typedef struct {
+    int base;
+    int quote;
+    double bid;
+    double ask;
+} currencyPair;
+
+// Balances in several currencies valued through the books of the pairs linking them
+typedef struct {
+    char codes[MAX_CURRENCIES][4];
+    double balances[MAX_CURRENCIES];
+    double rates[MAX_CURRENCIES];       // Value of one unit in the valuation currency, 0 if no path
+    int currencyCount;
+    currencyPair pairs[MAX_CURRENCY_PAIRS];
+    int pairCount;
+    int valuationCurrency;
+    int parentPair[MAX_CURRENCIES];     // Pair each currency was priced through, -1 for the valuation currency or none
+    int pairPrices[MAX_CURRENCY_PAIRS]; // Currency each pair prices, -1 if it prices nothing
+    bool ratesDirty;                    // The pair graph has changed shape since the rates were worked out
+    bool valueDirty;                    // The rates were worked out again, so the value needs a full re-sum
+    double cachedValue;
+} multiPortfolio;
+
 // Function declarations
 void update_portfolio(tradeType tradeDirection, double priceUsed, double volumeChange, userAccount *user);
+void portfolio_init(multiPortfolio *portfolio);
+int portfolio_add_currency(multiPortfolio *portfolio, const char *code);
+int portfolio_add_pair(multiPortfolio *portfolio, int base, int quote);
+void portfolio_set_valuation_currency(multiPortfolio *portfolio, int currency);
+void portfolio_update_book(multiPortfolio *portfolio, int pair, double bid, double ask);
+void portfolio_set_balance(multiPortfolio *portfolio, int currency, double balance);
+void portfolio_sync_account(multiPortfolio *portfolio, int base, int quote, const userAccount *account);
+double portfolio_rate(multiPortfolio *portfolio, int currency);
+double portfolio_value(multiPortfolio *portfolio);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,144 @@
+#include "risk.h"
+#include <limits.h>
+
+// Limits converted to fixed point -- disabled limits are LLONG_MAX so the compares always pass
+typedef struct {
+    long long maxPosition;
+    long long maxOrderVolume;
+    long long maxOrderNotional;     // In volume units * price units
+    long long maxOrdersPerWindow;
+    long long rateWindowNs;
+    long long priceBand;
+} fixedRiskLimits;
+
+static SIM_LOCAL fixedRiskLimits limits = {LLONG_MAX, LLONG_MAX, LLONG_MAX, LLONG_MAX, LLONG_MAX, LLONG_MAX};
+
+// Latest tick time and mid price, in fixed point
+static SIM_LOCAL long long currentTime = 0;
+static SIM_LOCAL long long referenceMid = 0;
+
+// Count of refused orders by reason
+static SIM_LOCAL long long rejections[RiskReasonCount];
+
+static const char *reasonNames[RiskReasonCount] = {"accepted", "order volume", "order notional", "position", "order rate", "price band"};
+
+
+// Convert a value to fixed point, rounding to nearest
+static long long to_units(double value, long long scale) {
+    double scaled = value * scale;
+    return (long long)(scaled >= 0 ? scaled + 0.5 : scaled - 0.5);
+}
+
+
+// Convert a limit to fixed point, with 0 meaning no limit
+static long long limit_units(double value, long long scale) {
+    return (value > 0) ? to_units(value, scale) : LLONG_MAX;
+}
+
+
+// Set the limits every new order is checked against
+void set_risk_limits(riskLimits newLimits) {
+    limits.maxPosition = limit_units(newLimits.maxPosition, RISK_VOLUME_SCALE);
+    limits.maxOrderVolume = limit_units(newLimits.maxOrderVolume, RISK_VOLUME_SCALE);
+    limits.maxOrderNotional = (newLimits.maxOrderNotional > 0) ? to_units(newLimits.maxOrderNotional, RISK_VOLUME_SCALE) * RISK_PRICE_SCALE : LLONG_MAX;
+    limits.maxOrdersPerWindow = (newLimits.maxOrdersPerWindow > 0) ? newLimits.maxOrdersPerWindow : LLONG_MAX;
+    limits.rateWindowNs = (newLimits.rateWindowNs > 0) ? newLimits.rateWindowNs : LLONG_MAX;
+    limits.priceBand = limit_units(newLimits.priceBand, RISK_PRICE_SCALE);
+}
+
+
+// Clear the reference price and rejection counts (limits are kept) -- positions and throttles live in each account
+void risk_reset() {
+    currentTime = 0;
+    referenceMid = 0;
+    memset(rejections, 0, sizeof(rejections));
+}
+
+
+// Record the time and mid price new orders are checked against
+void risk_on_tick(long long timestamp, double bidPrice, double askPrice) {
+    currentTime = timestamp;
+    referenceMid = to_units((bidPrice + askPrice) / 2.0, RISK_PRICE_SCALE);
+}
+
+
+// Take volume off an account's pending total -- orders that never passed the checks have none to take
+static void release_units(riskTotals *totals, tradeType type, long long units) {
+    long long *pending = (type == Bid) ? &totals->pendingBuy : &totals->pendingSell;
+    *pending = (*pending > units) ? *pending - units : 0;
+}
+
+
+// Keep an account's running position up to date -- called for every fill, moving the volume out of pending
+void risk_on_fill(riskTotals *totals, tradeType type, double volume) {
+    long long units = to_units(volume, RISK_VOLUME_SCALE);
+    totals->position += (type == Bid) ? units : -units;
+    release_units(totals, type, units);
+}
+
+
+// Stop counting an order's unfilled volume against its account -- called when it's cancelled or dropped
+void risk_on_release(riskTotals *totals, tradeType type, double volume) {
+    release_units(totals, type, to_units(volume, RISK_VOLUME_SCALE));
+}
+
+
+// Check a new order against the limits, returning why it was refused (or RiskAccepted). The position limit counts
+// every resting order on the same side as if it had filled, and an accepted order's volume is added to pending
+riskResult risk_check_order(riskTotals *totals, tradeType type, double price, double volume) {
+    long long volumeUnits = to_units(volume, RISK_VOLUME_SCALE);
+    long long priceUnits = to_units(price, RISK_PRICE_SCALE);
+    long long positionAfter = (type == Bid) ? totals->position + totals->pendingBuy + volumeUnits : totals->position - totals->pendingSell - volumeUnits;
+    long long distance = priceUnits - referenceMid;
+    riskResult result = RiskAccepted;
+
+    if (volumeUnits > limits.maxOrderVolume) {
+        result = RiskOrderVolume;
+    } else if (volumeUnits * priceUnits > limits.maxOrderNotional) {
+        result = RiskOrderNotional;
+    } else if ((type == Bid) ? positionAfter > limits.maxPosition : -positionAfter > limits.maxPosition) {
+        // Orders that reduce an oversized position are still allowed
+        result = RiskPosition;
+    } else if (referenceMid != 0 && (distance > limits.priceBand || -distance > limits.priceBand)) {
+        result = RiskPriceBand;
+    } else {
+        // Start a new throttle window for the account if its current one has passed
+        if (currentTime - totals->rateWindowStart >= limits.rateWindowNs) {
+            totals->rateWindowStart = currentTime;
+            totals->ordersInWindow = 0;
+        }
+        if (totals->ordersInWindow >= limits.maxOrdersPerWindow) {
+            result = RiskOrderRate;
+        } else {
+            totals->ordersInWindow++;
+            if (type == Bid) {
+                totals->pendingBuy += volumeUnits;
+            } else {
+                totals->pendingSell += volumeUnits;
+            }
+        }
+    }
+    rejections[result]++;
+    return result;
+}
+
+
+// Number of orders refused for a reason (RiskAccepted gives the number let through)
+long long risk_rejection_count(riskResult reason) {
+    return rejections[reason];
+}
+
+
+// Display how many orders the risk gate let through and refused
+void print_risk_report() {
+    long long refused = 0;
+    for (int i = RiskAccepted + 1; i < RiskReasonCount; i++) {
+        refused += rejections[i];
+    }
+    printf("Risk checks: %lld accepted, %lld rejected\n", rejections[RiskAccepted], refused);
+    for (int i = RiskAccepted + 1; i < RiskReasonCount; i++) {
+        if (rejections[i] > 0) {
+            printf("  %-16s %lld\n", reasonNames[i], rejections[i]);
+        }
+    }
+}
\ No newline at end of file
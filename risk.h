@@ -0,0 +1,49 @@
+#ifndef RISK_H
+#define RISK_H
+
+// Standard includes
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+
+// Inlcudes from other project headers
+#include "order_book.h"
+
+// Fixed point scales -- limits and running totals are integers so each check is a few compares
+#define RISK_PRICE_SCALE 100000LL       // Prices in 0.00001 steps
+#define RISK_VOLUME_SCALE 1000000LL     // Volumes in 0.000001 lots
+
+// Pre-trade limits in normal units -- a value of 0 turns that check off
+typedef struct {
+    double maxPosition;         // Largest net base position (either direction) an order may lead to
+    double maxOrderVolume;      // Largest single order
+    double maxOrderNotional;    // Largest price * volume of a single order, in quote currency
+    int maxOrdersPerWindow;     // Order rate throttle
+    long long rateWindowNs;     // Length of the throttle window
+    double priceBand;           // Furthest an order price may be from the current mid
+} riskLimits;
+
+// Running totals kept per account, updated on every accepted order, fill and cancel
+typedef struct {
+    long long position;         // Net base position in volume units
+    long long pendingBuy;       // Unfilled volume of accepted bids
+    long long pendingSell;      // Unfilled volume of accepted asks
+    long long rateWindowStart;  // Start of the account's order rate throttle window
+    long long ordersInWindow;   // Orders accepted in that window
+} riskTotals;
+
+// Reasons an order can be refused
+typedef enum {RiskAccepted, RiskOrderVolume, RiskOrderNotional, RiskPosition, RiskOrderRate, RiskPriceBand, RiskReasonCount} riskResult;
+
+// Function declarations
+void set_risk_limits(riskLimits limits);
+void risk_reset();
+void risk_on_tick(long long timestamp, double bidPrice, double askPrice);
+void risk_on_fill(riskTotals *totals, tradeType type, double volume);
+void risk_on_release(riskTotals *totals, tradeType type, double volume);
+riskResult risk_check_order(riskTotals *totals, tradeType type, double price, double volume);
+long long risk_rejection_count(riskResult reason);
+void print_risk_report();
+
+#endif
\ No newline at end of file
@@ -1,31 +1,58 @@
 #include "strategy.h"
+#include "alloc_track.h"
 
 // Define a starting index for orders to use as a key if needed
-int countID = 0;
+SIM_LOCAL int countID = 0;
+
+// Strategies registered to run on each tick
+static SIM_LOCAL strategySlot strategies[MAX_STRATEGIES];
+static SIM_LOCAL int strategyCount = 0;
+
+// Strategy whose callback is currently running -- new orders belong to it
+static SIM_LOCAL int activeStrategy = -1;
+
+// Number of fills reported since the strategies were last cleared
+static SIM_LOCAL int fillCount = 0;
+
+// Journal every fill is written to -- NULL when journalling is off
+static SIM_LOCAL fillJournal *activeJournal = NULL;
+
+
+// Account that orders made right now should trade for
+static userAccount *active_account() {
+    return (activeStrategy >= 0) ? strategies[activeStrategy].account : &user;
+}
 
 order *create_order(tradeType type, double price, double volume, orderType fill) {
    // Return an error message if a user tries to overload the hashtable -- Consider changing this
-   if (freeSpace <= 0) {
+   if (freeSpace - pending_order_count() <= 0) {
         printf("Reached Maximum Number of Outgoing Orders!\n");
         return NULL;
    }
    // Check if the user has enough of the correct currency to fulfill the trade
-   if ((type == Bid && (price*volume) > user.quoteCurrencyBalance) || (type == Ask && volume > user.baseCurrencyBalance)) {
+   userAccount *account = active_account();
+   if ((type == Bid && (price*volume) > account->quoteCurrencyBalance) || (type == Ask && volume > account->baseCurrencyBalance)) {
+        return NULL;
+   }
+   // Check the order against the pre-trade risk limits -- rejections are counted by reason
+   if (risk_check_order(&account->risk, type, price, volume) != RiskAccepted) {
         return NULL;
    }
    // Create new order
-   order *newOrder = (order*) malloc(sizeof(order));
+   order *newOrder = (order*) tracked_malloc(AllocOrders, sizeof(order));
    newOrder->orderID = countID++;
    
    // Create orderData
-   newOrder->orderInfo = (orderData*) malloc(sizeof(orderData));
+   newOrder->orderInfo = (orderData*) tracked_malloc(AllocOrders, sizeof(orderData));
    newOrder->orderInfo->type = type;
    newOrder->orderInfo->price = price;
    newOrder->orderInfo->volume = volume;
    newOrder->orderInfo->fill = fill;
+   newOrder->orderInfo->owner = activeStrategy;
+   newOrder->orderInfo->account = account;
 
-   // Insert order into order hashtable
-   insert_order_byPointer(newOrder);
+   // Send order towards the hashtable -- it becomes live once its latency has passed
+   submit_order(newOrder);
    return newOrder;
 }
 
@@ -47,4 +74,218 @@ void check_and_react_supportResistance(double support, double resistance) {
 }
 
 
-/*In this file we can create new strategies to employ too*/
+
+
+//! Adaptive Support/Resistance -- levels follow rolling lows/highs instead of fixed macros
+// Set up the rolling windows used to find support and resistance
+void adaptive_sr_init(adaptiveSupportResistanceState *state, int windowTicks, long long windowNs, double supportBuffer, double resistanceBuffer) {
+    state->windowTicks = windowTicks;
+    state->windowNs = windowNs;
+    state->supportBuffer = supportBuffer;
+    state->resistanceBuffer = resistanceBuffer;
+    extreme_init(&state->askLow, false, windowTicks, windowNs, windowTicks);
+    extreme_init(&state->bidHigh, true, windowTicks, windowNs, windowTicks);
+    state->support = 0;
+    state->resistance = 0;
+    state->ticksSeen = 0;
+    state->firstTime = 0;
+}
+
+
+// Free the rolling windows
+void adaptive_sr_free(adaptiveSupportResistanceState *state) {
+    window_free(&state->askLow.deque);
+    window_free(&state->bidHigh.deque);
+}
+
+
+// Check current prices against the rolling levels, making an order if needed
+void check_and_react_adaptiveSupportResistance(adaptiveSupportResistanceState *state, double bidPrice, double bidVolume, double askPrice, double askVolume, long long timestamp) {
+    if (state->ticksSeen++ == 0) {
+        state->firstTime = timestamp;
+    }
+    // Only trade once a full window of history backs the levels
+    bool warmedUp = (state->windowNs > 0) ? timestamp - state->firstTime >= state->windowNs : state->ticksSeen > state->windowTicks;
+
+    if (warmedUp) {
+        // Buy as much as possible if the ask drops to the recent lows
+        if (askVolume > 0 && askPrice <= state->support + state->supportBuffer) {
+            create_order(Bid, askPrice, askVolume, Limit);
+        }
+        // Sell as much as possible if the bid rises to the recent highs
+        if (bidVolume > 0 && bidPrice >= state->resistance - state->resistanceBuffer) {
+            create_order(Ask, bidPrice, bidVolume, Limit);
+        }
+    }
+    // Fold this tick into the levels used on the next one
+    if (askVolume > 0) {
+        state->support = extreme_update(&state->askLow, askPrice, timestamp);
+    }
+    if (bidVolume > 0) {
+        state->resistance = extreme_update(&state->bidHigh, bidPrice, timestamp);
+    }
+}
+
+
+//! Strategy Registry -- Lets several strategies run in one pass over the data
+// Register a strategy to run each tick, returning its index (or -1 if full)
+int register_strategy(const strategyVTable *vtable, void *state, userAccount *account) {
+    if (strategyCount >= MAX_STRATEGIES) {
+        printf("Reached Maximum Number of Strategies!\n");
+        return -1;
+    }
+    strategies[strategyCount] = (strategySlot){vtable, state, account, {0}};
+    return strategyCount++;
+}
+
+
+// Remove all registered strategies
+void clear_strategies() {
+    strategyCount = 0;
+    activeStrategy = -1;
+    fillCount = 0;
+}
+
+
+// Fill in a top of book view from the current bid and ask trees
+void build_book_view(bookView *book, const orderLine *line, long long timestamp, long long tick) {
+    node *best_bid = find_best_node(&bidTree);
+    node *best_ask = find_best_node(&askTree);
+
+    book->bidPrice = (best_bid != NULL) ? best_bid->price : 0.0;
+    book->bidVolume = (best_bid != NULL) ? best_bid->volume : 0.0;
+    book->askPrice = (best_ask != NULL) ? best_ask->price : 0.0;
+    book->askVolume = (best_ask != NULL) ? best_ask->volume : 0.0;
+    book->timestamp = timestamp;
+    book->tick = tick;
+    book->line = line;
+}
+
+
+// Give each strategy a chance to set itself up before the first tick
+void strategies_init() {
+    for (int i = 0; i < strategyCount; i++) {
+        if (strategies[i].vtable->init) {
+            activeStrategy = i;
+            strategies[i].vtable->init(strategies[i].state);
+        }
+    }
+    activeStrategy = -1;
+}
+
+
+// Pass the latest top of book to every strategy
+void strategies_on_tick(const bookView *book) {
+    for (int i = 0; i < strategyCount; i++) {
+        // Analytics are marked at the bid, the same price the account is valued at
+        pnlAnalytics *stats = &strategies[i].analytics;
+        if (!stats->started) {
+            analytics_start(stats, strategies[i].account->baseCurrencyBalance, strategies[i].account->quoteCurrencyBalance, book->bidPrice);
+        }
+        analytics_on_tick(stats, book->bidPrice);
+
+        activeStrategy = i;
+        strategies[i].vtable->on_tick(strategies[i].state, book);
+    }
+    activeStrategy = -1;
+}
+
+
+// Let every strategy know the data has finished
+void strategies_on_end(const bookView *book) {
+    for (int i = 0; i < strategyCount; i++) {
+        if (strategies[i].vtable->on_end) {
+            activeStrategy = i;
+            strategies[i].vtable->on_end(strategies[i].state, book);
+        }
+    }
+    activeStrategy = -1;
+}
+
+
+// Called by the matching engine whenever part of an order is filled
+void report_fill(order *filledOrder, double price, double volume) {
+    fillCount++;
+    int owner = filledOrder->orderInfo->owner;
+    tradeType side = filledOrder->orderInfo->type;
+
+    if (activeJournal != NULL) {
+        userAccount *account = filledOrder->orderInfo->account;
+        fillRecord record = {order_clock_time(), price, volume, account->baseCurrencyBalance, account->quoteCurrencyBalance,
+                             filledOrder->orderID, (uint8_t) side, (uint8_t) owner, {0}};
+        journal_write_fill(activeJournal, &record);
+    }
+    if (owner < 0 || owner >= strategyCount) {
+        return;
+    }
+    analytics_on_fill(&strategies[owner].analytics, side == Bid, price, volume);
+    if (strategies[owner].vtable->on_fill == NULL) {
+        return;
+    }
+    fillReport fill = {filledOrder->orderID, side, price, volume};
+
+    // Orders made from within on_fill belong to the same strategy
+    int previous = activeStrategy;
+    activeStrategy = owner;
+    strategies[owner].vtable->on_fill(strategies[owner].state, &fill);
+    activeStrategy = previous;
+}
+
+
+// Print each strategy's balances and value at a given price
+void print_strategy_results(double markPrice) {
+    printf("%-28s %14s %14s %14s\n", "Strategy", "Base", "Quote", "Value(quote)");
+    for (int i = 0; i < strategyCount; i++) {
+        userAccount *account = strategies[i].account;
+        printf("%-28s %14.6f %14.6f %14.6f\n", strategies[i].vtable->name, account->baseCurrencyBalance,
+               account->quoteCurrencyBalance, account->baseCurrencyBalance * markPrice + account->quoteCurrencyBalance);
+    }
+    printf("\n%-28s %12s %12s %12s %8s %8s %10s\n", "Strategy", "Realised", "Unrealised", "MaxDD", "Trades", "Win%", "Sharpe");
+    for (int i = 0; i < strategyCount; i++) {
+        pnlAnalytics *stats = &strategies[i].analytics;
+        printf("%-28s %12.6f %12.6f %12.6f %8lld %7.1f%% %10.4f\n", strategies[i].vtable->name, stats->realisedPnL,
+               stats->unrealisedPnL, stats->maxDrawdown, stats->trades, analytics_win_rate(stats) * 100.0, analytics_sharpe(stats));
+    }
+}
+
+
+// Number of fills since the strategies were last cleared
+int fills_reported() {
+    return fillCount;
+}
+
+
+// Write every fill to a journal from now on (NULL stops journalling)
+void set_fill_journal(fillJournal *journal) {
+    activeJournal = journal;
+}
+
+
+//! Registered Strategies
+// Support/Resistance driven by the tick's book view rather than the trees
+static void supportResistance_on_tick(void *state, const bookView *book) {
+    supportResistanceState *levels = (supportResistanceState*) state;
+
+    // Buy as much as possible if price falls below support
+    if (book->askVolume > 0 && book->askPrice <= levels->support) {
+        create_order(Bid, book->askPrice, book->askVolume, Limit);
+    }
+    // Sell as much as possible if price rises above resistance
+    if (book->bidVolume > 0 && book->bidPrice >= levels->resistance) {
+        create_order(Ask, book->bidPrice, book->bidVolume, Limit);
+    }
+}
+
+const strategyVTable supportResistanceStrategy = {"support_resistance", NULL, supportResistance_on_tick, NULL, NULL};
+
+
+// Adaptive Support/Resistance -- state must be set up with adaptive_sr_init before registering
+static void adaptiveSupportResistance_on_tick(void *state, const bookView *book) {
+    check_and_react_adaptiveSupportResistance((adaptiveSupportResistanceState*) state, book->bidPrice, book->bidVolume,
+                                              book->askPrice, book->askVolume, book->timestamp);
+}
+
+const strategyVTable adaptiveSupportResistanceStrategy = {"adaptive_support_resistance", NULL, adaptiveSupportResistance_on_tick, NULL, NULL};
+
+
+/*In this file we can create new strategies to employ too -- fill in a strategyVTable and register it in main()*/
@@ -11,13 +11,90 @@
 // My code includes
 #include "matching.h"
 #include "portfolio_tracker.h"
+#include "latency.h"
+#include "indicators.h"
+#include "journal.h"
+
+// Define how many strategies can run side by side in one pass over the data
+#define MAX_STRATEGIES 16
+
+// Read-only view of the top of the book handed to strategies each tick
+typedef struct {
+    double bidPrice;
+    double bidVolume;
+    double askPrice;
+    double askVolume;
+    long long timestamp;    // Tick time in ns since epoch
+    long long tick;         // Number of ticks processed so far
+    const orderLine *line;  // Raw tick -- lets strategies feed their indicators
+} bookView;
+
+// Details of a (partial) fill handed back to the strategy that placed the order
+typedef struct {
+    int orderID;
+    tradeType type;
+    double price;
+    double volume;
+} fillReport;
+
+// Callbacks a strategy provides -- state is the strategy's own opaque data
+typedef struct {
+    const char *name;
+    void (*init)(void *state);
+    void (*on_tick)(void *state, const bookView *book);
+    void (*on_fill)(void *state, const fillReport *fill);
+    void (*on_end)(void *state, const bookView *book);
+} strategyVTable;
+
+// A strategy registered to run, along with the account it trades
+typedef struct {
+    const strategyVTable *vtable;
+    void *state;
+    userAccount *account;
+    pnlAnalytics analytics;     // Running P&L of the strategy's account
+} strategySlot;
+
+// State for the basic support/resistance strategy
+typedef struct {
+    double support;
+    double resistance;
+} supportResistanceState;
+
+// State for the adaptive support/resistance strategy -- levels come from rolling extremes of the book
+typedef struct {
+    int windowTicks;            // Window length in ticks (or max samples kept if windowNs > 0)
+    long long windowNs;         // Time based window if > 0
+    double supportBuffer;       // Buy when ask <= support + supportBuffer
+    double resistanceBuffer;    // Sell when bid >= resistance - resistanceBuffer
+    rollingExtreme askLow;      // Rolling low of best ask -- gives support
+    rollingExtreme bidHigh;     // Rolling high of best bid -- gives resistance
+    double support;             // Levels in use, taken from ticks before the current one
+    double resistance;
+    long long ticksSeen;
+    long long firstTime;
+} adaptiveSupportResistanceState;
 
 // Declaring global variables
-extern userAccount user;
-extern int freeSpace;
+extern SIM_LOCAL userAccount user;
+extern SIM_LOCAL int freeSpace;
+extern SIM_LOCAL int countID;
+extern const strategyVTable supportResistanceStrategy;
+extern const strategyVTable adaptiveSupportResistanceStrategy;
 
 // Function declarations
 order *create_order(tradeType type, double price, double volume, orderType fill);
+int register_strategy(const strategyVTable *vtable, void *state, userAccount *account);
+void clear_strategies();
+void build_book_view(bookView *book, const orderLine *line, long long timestamp, long long tick);
+void strategies_init();
+void strategies_on_tick(const bookView *book);
+void strategies_on_end(const bookView *book);
+void print_strategy_results(double markPrice);
+int fills_reported();
+void set_fill_journal(fillJournal *journal);
 void check_and_react_supportResistance(double support, double resistance);
+void adaptive_sr_init(adaptiveSupportResistanceState *state, int windowTicks, long long windowNs, double supportBuffer, double resistanceBuffer);
+void adaptive_sr_free(adaptiveSupportResistanceState *state);
+void check_and_react_adaptiveSupportResistance(adaptiveSupportResistanceState *state, double bidPrice, double bidVolume, double askPrice, double askVolume, long long timestamp);
 
 #endif
\ No newline at end of file
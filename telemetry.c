@@ -0,0 +1,259 @@
+#define _GNU_SOURCE
+#include "telemetry.h"
+
+#ifndef _WIN32
+    #include <errno.h>
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <time.h>
+#endif
+
+
+// Open a UDP socket towards the grapher -- false (and nothing is sent) if it can't be created
+bool telemetry_open(telemetrySender *sender, const char *host, int port) {
+    memset(sender, 0, sizeof(*sender));
+#ifdef _WIN32
+    // initialise Winsock for Windows machine
+    WSADATA wsaData;
+    int result = WSAStartup(MAKEWORD(2,2), &wsaData);
+    if (result != 0) {
+        printf("WSAStartup failed with error %d\n", result);
+        return false;
+    }
+    sender->socket = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (sender->socket == INVALID_SOCKET) {
+        printf("Failed to create UDP socket: %d\n", WSAGetLastError());
+        WSACleanup();
+        return false;
+    }
+#else
+    sender->socket = socket(AF_INET, SOCK_DGRAM, 0);
+    if (sender->socket < 0) {
+        printf("Failed to create UDP socket\n");
+        return false;
+    }
+#endif
+    sender->address.sin_family = AF_INET;
+    sender->address.sin_port = htons(port);
+    sender->address.sin_addr.s_addr = inet_addr(host);
+    sender->open = true;
+
+    printf("UDP Initialised for graphing - Python script should be running on port %d\n", port);
+    return true;
+}
+
+
+// Map (creating if needed) the shared memory ring graphing.py --shm reads -- false if it can't be, so the caller
+// can fall back to UDP
+bool telemetry_open_shm(telemetrySender *sender, const char *name, uint32_t slots) {
+    memset(sender, 0, sizeof(*sender));
+#ifdef _WIN32
+    (void) name;
+    (void) slots;
+    printf("Shared memory telemetry is not supported on this platform\n");
+    return false;
+#else
+    size_t ringBytes = sizeof(telemetryRingHeader) + (size_t) slots * sizeof(telemetryRingSlot);
+    int fd = shm_open(name, O_CREAT | O_RDWR, 0600);
+    if (fd < 0) {
+        printf("Failed to open shared memory %s: %s\n", name, strerror(errno));
+        return false;
+    }
+    if (ftruncate(fd, (off_t) ringBytes) != 0) {
+        printf("Failed to size shared memory %s: %s\n", name, strerror(errno));
+        close(fd);
+        return false;
+    }
+    void *mapping = mmap(NULL, ringBytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        printf("Failed to map shared memory %s: %s\n", name, strerror(errno));
+        return false;
+    }
+
+    // The object is reused between runs so a reader that has it mapped keeps up -- the run ID tells it a new run
+    // started and the sequence numbers begin again
+    telemetryRingHeader *ring = mapping;
+    ring->magic = 0;
+    atomic_thread_fence(memory_order_release);
+    atomic_store_explicit(&ring->writeSequence, 0, memory_order_relaxed);
+    memset((unsigned char*) mapping + sizeof(telemetryRingHeader), 0, ringBytes - sizeof(telemetryRingHeader));
+    ring->version = TELEMETRY_VERSION;
+    ring->slotCount = slots;
+    ring->slotBytes = sizeof(telemetryRingSlot);
+    ring->runId = ((uint64_t) time(NULL) << 32) | (uint32_t) getpid();
+    atomic_thread_fence(memory_order_release);
+    ring->magic = TELEMETRY_RING_MAGIC;
+
+    sender->transport = TransportShm;
+    sender->ring = ring;
+    sender->ringBytes = ringBytes;
+    sender->open = true;
+    printf("Shared memory ring %s initialised for graphing - run graphing.py --shm\n", name);
+    return true;
+#endif
+}
+
+
+// Slot packet n is written into
+static telemetryRingSlot *ring_slot(telemetrySender *sender, uint64_t n) {
+    telemetryRingSlot *slots = (telemetryRingSlot*) (sender->ring + 1);
+    return &slots[n % sender->ring->slotCount];
+}
+
+
+// Buffer the packet being filled lives in -- straight in the ring for shared memory, so publishing it needs no copy
+static unsigned char *current_packet(telemetrySender *sender) {
+    if (sender->transport == TransportShm) {
+        return ring_slot(sender, sender->sequence)->packet;
+    }
+    return sender->packets[sender->packetCount];
+}
+
+
+// Hand every finished packet to the kernel -- one sendmmsg call on Linux, a sendto each elsewhere
+static void send_packets(telemetrySender *sender) {
+    if (sender->packetCount == 0) {
+        return;
+    }
+#if defined(__linux__)
+    struct mmsghdr messages[TELEMETRY_SEND_BATCH];
+    struct iovec parts[TELEMETRY_SEND_BATCH];
+    memset(messages, 0, sizeof(messages));
+    for (int i = 0; i < sender->packetCount; i++) {
+        parts[i].iov_base = sender->packets[i];
+        parts[i].iov_len = sender->packetLengths[i];
+        messages[i].msg_hdr.msg_name = &sender->address;
+        messages[i].msg_hdr.msg_namelen = sizeof(sender->address);
+        messages[i].msg_hdr.msg_iov = &parts[i];
+        messages[i].msg_hdr.msg_iovlen = 1;
+    }
+    int sent = 0;
+    while (sent < sender->packetCount) {
+        int result = sendmmsg(sender->socket, messages + sent, sender->packetCount - sent, 0);
+        if (result <= 0) {
+            // Telemetry is best effort -- the rest of this batch is dropped rather than retried
+            sender->sendErrors += sender->packetCount - sent;
+            break;
+        }
+        sent += result;
+    }
+    sender->packetsSent += sent;
+#else
+    for (int i = 0; i < sender->packetCount; i++) {
+        if (sendto(sender->socket, (const char*) sender->packets[i], sender->packetLengths[i], 0,
+                   (struct sockaddr*) &sender->address, sizeof(sender->address)) < 0) {
+            sender->sendErrors++;
+        } else {
+            sender->packetsSent++;
+        }
+    }
+#endif
+    sender->packetCount = 0;
+}
+
+
+// Fill in the header of the packet being built and queue it for sending, or publish it to the ring
+static void finish_packet(telemetrySender *sender) {
+    if (sender->recordCount == 0) {
+        return;
+    }
+    telemetryHeader header = {TELEMETRY_MAGIC, TELEMETRY_VERSION, sender->recordKind, (uint32_t) sender->sequence,
+                              (uint16_t) sender->recordCount, sender->recordSize};
+    int length = (int) (sizeof(header) + sender->recordSize * sender->recordCount);
+    memcpy(current_packet(sender), &header, sizeof(header));
+    sender->recordCount = 0;
+
+    if (sender->transport == TransportShm) {
+        // Releasing the slot's sequence makes the packet visible, then the write sequence tells the reader it's there
+        telemetryRingSlot *slot = ring_slot(sender, sender->sequence);
+        slot->length = (uint32_t) length;
+        atomic_store_explicit(&slot->sequence, sender->sequence + 1, memory_order_release);
+        atomic_store_explicit(&sender->ring->writeSequence, sender->sequence + 1, memory_order_release);
+        sender->sequence++;
+        sender->packetsSent++;
+        return;
+    }
+    sender->sequence++;
+    sender->packetLengths[sender->packetCount] = length;
+    sender->packetCount++;
+
+    if (sender->packetCount == TELEMETRY_SEND_BATCH) {
+        send_packets(sender);
+    }
+}
+
+
+// Add a record to the packet being built -- a packet holds one kind of record, so a new kind starts a new packet
+static void append_record(telemetrySender *sender, telemetryKind kind, const void *record, size_t recordSize) {
+    if (!sender->open) {
+        return;
+    }
+    if (sender->recordCount > 0 && (sender->recordKind != kind ||
+        sizeof(telemetryHeader) + recordSize * (sender->recordCount + 1) > TELEMETRY_PACKET_BYTES)) {
+        finish_packet(sender);
+    }
+    if (sender->recordCount == 0 && sender->transport == TransportShm) {
+        // Mark the slot as being written before touching it -- a reader still copying the packet it held will see
+        // the sequence change and throw its copy away
+        atomic_store_explicit(&ring_slot(sender, sender->sequence)->sequence, 0, memory_order_relaxed);
+        atomic_thread_fence(memory_order_release);
+    }
+    sender->recordKind = (uint16_t) kind;
+    sender->recordSize = (uint16_t) recordSize;
+    unsigned char *packet = current_packet(sender);
+    memcpy(packet + sizeof(telemetryHeader) + recordSize * sender->recordCount, record, recordSize);
+    sender->recordCount++;
+}
+
+
+// Queue one finished bar for the grapher
+void telemetry_send_bar(telemetrySender *sender, const barRecord *record) {
+    append_record(sender, TelemetryBar, record, sizeof(barRecord));
+}
+
+
+// Queue one point of a long-history view for the grapher
+void telemetry_send_history(telemetrySender *sender, const historyPoint *point) {
+    append_record(sender, TelemetryHistory, point, sizeof(historyPoint));
+}
+
+
+// Queue one changed depth level for the grapher
+void telemetry_send_depth(telemetrySender *sender, const depthRecord *record) {
+    append_record(sender, TelemetryDepth, record, sizeof(depthRecord));
+}
+
+
+// Send everything queued, including a part-filled packet
+void telemetry_flush(telemetrySender *sender) {
+    if (!sender->open) {
+        return;
+    }
+    finish_packet(sender);
+    send_packets(sender);
+}
+
+
+// Send what is left and close the socket or unmap the ring -- the ring itself is left for the reader to finish
+void telemetry_close(telemetrySender *sender) {
+    if (!sender->open) {
+        return;
+    }
+    telemetry_flush(sender);
+    sender->open = false;
+#ifndef _WIN32
+    if (sender->transport == TransportShm) {
+        munmap(sender->ring, sender->ringBytes);
+        sender->ring = NULL;
+        return;
+    }
+#endif
+#ifdef _WIN32
+    closesocket(sender->socket);
+    WSACleanup();
+#else
+    close(sender->socket);
+#endif
+}
\ No newline at end of file
@@ -0,0 +1,159 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+// Standard includes
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdatomic.h>
+
+// Sockets for the UDP transport
+#ifdef _WIN32
+    #include <winsock2.h>
+    #include <ws2tcpip.h>
+#else
+    #include <sys/socket.h>
+    #include <netinet/in.h>
+    #include <arpa/inet.h>
+    #include <unistd.h>
+#endif
+
+// Define the telemetry wire format -- graphing.py decodes the same layout
+#define TELEMETRY_MAGIC 0x4D4C4554          // "TELM"
+#define TELEMETRY_VERSION 1
+#define TELEMETRY_PORT 8888
+#define TELEMETRY_PACKET_BYTES 1472         // Largest datagram that fits a 1500 byte MTU unfragmented
+#define TELEMETRY_SEND_BATCH 16             // Full datagrams handed to the kernel per sendmmsg
+#define TELEMETRY_RING_NAME "/trading_telemetry"    // Shared memory object (/dev/shm/trading_telemetry on Linux)
+#define TELEMETRY_RING_MAGIC 0x474E5254     // "TRNG"
+#define TELEMETRY_RING_SLOTS 4096           // Packets the ring holds before the oldest is overwritten
+#define TELEMETRY_DEPTH_PRICE_TICK 0.00001  // Depth prices are sent as whole numbers of this
+
+// Kinds of record a packet can carry -- 1 was raw ticks, which are now downsampled by the publisher instead
+typedef enum {TelemetryBar = 2, TelemetryHistory = 3, TelemetryDepth = 4} telemetryKind;
+
+// Header at the start of every packet -- 16 bytes, little-endian
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t kind;              // telemetryKind of every record in the packet
+    uint32_t sequence;          // Packet number -- a gap means packets were lost
+    uint16_t count;             // Records following the header
+    uint16_t recordSize;
+} telemetryHeader;
+
+// Top of book and portfolio value after one tick -- 40 bytes, little-endian, no padding
+typedef struct {
+    int64_t line;               // Tick number in the data file
+    int64_t timestamp;          // Tick time in ns since epoch
+    double bid;
+    double ask;
+    double value;               // Portfolio value in the quote currency
+} tickRecord;
+
+// Open/high/low/close of the bid and ask and the last portfolio value over one bucket of ticks -- 104 bytes
+typedef struct {
+    int64_t firstLine;
+    int64_t lastLine;
+    int64_t startTime;          // Bucket start in ns -- the first tick's time for tick buckets
+    int64_t endTime;            // Last tick's time in ns
+    double bidOpen;
+    double bidHigh;
+    double bidLow;
+    double bidClose;
+    double askOpen;
+    double askHigh;
+    double askLow;
+    double askClose;
+    double value;
+} barRecord;
+
+// Series carried by a history point
+typedef enum {HistoryPrice = 0, HistoryValue = 1} historySeries;
+
+// One point of the LTTB-reduced long history -- 32 bytes. A history is sent as one generation of points
+// covering every bar so far, and replaces the last one once all total points have arrived
+typedef struct {
+    int64_t line;
+    double primary;             // Bid close for HistoryPrice, portfolio value for HistoryValue
+    double secondary;           // Ask close for HistoryPrice, unused for HistoryValue
+    uint32_t generation;
+    uint16_t series;
+    uint16_t total;             // Points in this generation across both series
+} historyPoint;
+
+// Flags on a depth record
+#define DEPTH_SNAPSHOT 0x01             // Part of a full snapshot
+#define DEPTH_SNAPSHOT_START 0x02       // First record of a full snapshot -- the reader clears its book and is in sync again
+
+// One changed price level of the depth stream -- 16 bytes. A volume of 0 means the level is gone
+typedef struct {
+    uint32_t line;              // Tick the book was captured on
+    int32_t priceTicks;         // Price in TELEMETRY_DEPTH_PRICE_TICKs
+    float volume;
+    uint8_t side;               // tradeType -- 0 bid, 1 ask
+    uint8_t flags;
+    uint16_t reserved;
+} depthRecord;
+
+// Start of the shared memory ring -- the write sequence sits on its own cache line so the reader polling it
+// doesn't share a line with anything else
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t reserved;
+    uint32_t slotCount;
+    uint32_t slotBytes;
+    uint64_t runId;                     // Changes each time a run opens the ring -- a reader seeing it change starts over
+    unsigned char padding[40];
+    _Atomic uint64_t writeSequence;     // Packets published so far -- packet n lives in slot n % slotCount
+    unsigned char padding2[56];
+} telemetryRingHeader;
+
+// One packet in the ring -- sequence is n + 1 once packet n is complete and 0 while it is being written,
+// so a reader that sees the same value either side of its copy knows the copy is whole
+typedef struct {
+    _Atomic uint64_t sequence;
+    uint32_t length;
+    uint32_t reserved;
+    unsigned char packet[TELEMETRY_PACKET_BYTES];
+} telemetryRingSlot;
+
+// Where packets go once they are full
+typedef enum {TransportUdp, TransportShm} telemetryTransport;
+
+// Records gathered into packets and either sent over UDP in batches or published into the shared memory ring
+typedef struct {
+    telemetryTransport transport;
+#ifdef _WIN32
+    SOCKET socket;
+#else
+    int socket;
+#endif
+    bool open;
+    struct sockaddr_in address;
+    unsigned char packets[TELEMETRY_SEND_BATCH][TELEMETRY_PACKET_BYTES];
+    int packetLengths[TELEMETRY_SEND_BATCH];
+    int packetCount;            // Packets finished and waiting to be sent
+    int recordCount;            // Records in the packet being filled
+    uint16_t recordKind;
+    uint16_t recordSize;
+    uint64_t sequence;          // Next packet number -- the header carries its low 32 bits
+    unsigned long long packetsSent;
+    unsigned long long sendErrors;
+    telemetryRingHeader *ring;  // Mapped ring when transport is TransportShm
+    size_t ringBytes;
+} telemetrySender;
+
+// Function declarations
+bool telemetry_open(telemetrySender *sender, const char *host, int port);
+bool telemetry_open_shm(telemetrySender *sender, const char *name, uint32_t slots);
+void telemetry_send_bar(telemetrySender *sender, const barRecord *record);
+void telemetry_send_history(telemetrySender *sender, const historyPoint *point);
+void telemetry_send_depth(telemetrySender *sender, const depthRecord *record);
+void telemetry_flush(telemetrySender *sender);
+void telemetry_close(telemetrySender *sender);
+
+#endif
\ No newline at end of file
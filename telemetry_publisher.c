@@ -0,0 +1,382 @@
+#include "telemetry_publisher.h"
+#include "alloc_track.h"
+#include "benchmark.h"
+#include <pthread.h>
+#include <stdatomic.h>
+
+// Single producer (the trading thread) / single consumer (the publisher) queue that never makes the producer wait --
+// when it is full the newest item overwrites the oldest. Each slot starts with the number of the item it holds
+// plus one (0 while being written) so the consumer can tell when it has been lapped or an item changed under it
+typedef struct {
+    unsigned char *slots;
+    size_t slotBytes;
+    size_t itemBytes;
+    unsigned long long mask;
+    atomic_ullong writeSequence;        // Items pushed so far -- only the producer moves it
+    char writePadding[64];
+    unsigned long long readSequence;    // Next item the consumer takes -- only the consumer touches it
+    unsigned long long dropped;
+} snapshotQueue;
+
+// Close of every bar so far, reduced for the long-history view
+typedef struct {
+    double *line;
+    double *bid;
+    double *ask;
+    double *value;
+    double *mid;                // Scratch -- the series LTTB keeps the price shape of
+    int *selected;              // Scratch -- indices picked by LTTB, room for both series
+    int count;
+    int points;                 // Points per series sent in each history
+    uint32_t generation;
+    int barsSinceSent;
+    double lastSentMs;          // Wall-clock time of the last history sent
+} barHistory;
+
+// The queue of ticks, the sender it drains into and the thread doing the draining
+static snapshotQueue tickQueue;
+static telemetrySender *publisherSender = NULL;
+static pthread_t publisherThread;
+static atomic_bool publisherStop = false;
+static bool publisherRunning = false;
+
+// Downsampling done by the publisher before anything is sent
+static barAggregator bars;
+static barHistory history;
+
+// Depth snapshots from the trading thread and the encoder turning them into changed levels -- only when enabled
+static snapshotQueue depthQueue;
+static depthEncoder depth;
+static bool depthEnabled = false;
+
+
+// Allocate a queue of a power of two slots for items of a fixed size
+static bool queue_init(snapshotQueue *queue, size_t itemBytes, unsigned long long slots) {
+    queue->itemBytes = itemBytes;
+    queue->slotBytes = sizeof(atomic_ullong) + ((itemBytes + 7) & ~(size_t) 7);
+    queue->mask = slots - 1;
+    queue->slots = tracked_calloc(AllocTelemetry, slots, queue->slotBytes);
+    atomic_store(&queue->writeSequence, 0);
+    queue->readSequence = 0;
+    queue->dropped = 0;
+    return queue->slots != NULL;
+}
+
+
+// Free a queue's slots
+static void queue_free(snapshotQueue *queue) {
+    tracked_free(AllocTelemetry, queue->slots, (queue->mask + 1) * queue->slotBytes);
+    queue->slots = NULL;
+}
+
+
+// Sequence word at the start of a slot
+static atomic_ullong *slot_sequence(snapshotQueue *queue, unsigned long long n) {
+    return (atomic_ullong*) (queue->slots + (n & queue->mask) * queue->slotBytes);
+}
+
+
+// Copy an item into the next slot -- a fixed number of stores whatever the consumer is doing
+static void queue_push(snapshotQueue *queue, const void *item) {
+    unsigned long long n = atomic_load_explicit(&queue->writeSequence, memory_order_relaxed);
+    atomic_ullong *sequence = slot_sequence(queue, n);
+    atomic_store_explicit(sequence, 0, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    memcpy(sequence + 1, item, queue->itemBytes);
+    atomic_store_explicit(sequence, n + 1, memory_order_release);
+    atomic_store_explicit(&queue->writeSequence, n + 1, memory_order_release);
+}
+
+
+// Take the oldest item still held -- false when there is nothing new. Items the producer overwrote first are
+// counted as dropped
+static bool queue_pop(snapshotQueue *queue, void *item) {
+    unsigned long long written = atomic_load_explicit(&queue->writeSequence, memory_order_acquire);
+    while (queue->readSequence < written) {
+        // Lapped -- everything more than a queue behind the producer is gone
+        if (written - queue->readSequence > queue->mask + 1) {
+            queue->dropped += written - (queue->mask + 1) - queue->readSequence;
+            queue->readSequence = written - (queue->mask + 1);
+        }
+        unsigned long long n = queue->readSequence++;
+        atomic_ullong *sequence = slot_sequence(queue, n);
+        if (atomic_load_explicit(sequence, memory_order_acquire) != n + 1) {
+            queue->dropped++;
+            continue;
+        }
+        memcpy(item, sequence + 1, queue->itemBytes);
+        atomic_thread_fence(memory_order_acquire);
+        // The producer came round again while we copied -- the copy may be torn
+        if (atomic_load_explicit(sequence, memory_order_relaxed) != n + 1) {
+            queue->dropped++;
+            continue;
+        }
+        return true;
+    }
+    return false;
+}
+
+
+// Allocate the bar history's columns and scratch space
+static void history_init(barHistory *bars, int points) {
+    memset(bars, 0, sizeof(*bars));
+    double **columns[] = {&bars->line, &bars->bid, &bars->ask, &bars->value, &bars->mid};
+    for (size_t i = 0; i < sizeof(columns) / sizeof(columns[0]); i++) {
+        *columns[i] = tracked_malloc(AllocTelemetry, sizeof(double) * PUBLISHER_HISTORY_CAPACITY);
+        if (*columns[i] == NULL) {
+            printf("Error Allocating Memory!\n");
+            exit(-1);
+        }
+    }
+    bars->selected = tracked_malloc(AllocTelemetry, sizeof(int) * 2 * PUBLISHER_HISTORY_CAPACITY);
+    if (bars->selected == NULL) {
+        printf("Error Allocating Memory!\n");
+        exit(-1);
+    }
+    bars->points = (points > PUBLISHER_MAX_HISTORY_POINTS) ? PUBLISHER_MAX_HISTORY_POINTS : points;
+    bars->lastSentMs = get_time_ms();
+}
+
+
+// Free the bar history
+static void history_free(barHistory *bars) {
+    double **columns[] = {&bars->line, &bars->bid, &bars->ask, &bars->value, &bars->mid};
+    for (size_t i = 0; i < sizeof(columns) / sizeof(columns[0]); i++) {
+        tracked_free(AllocTelemetry, *columns[i], sizeof(double) * PUBLISHER_HISTORY_CAPACITY);
+        *columns[i] = NULL;
+    }
+    tracked_free(AllocTelemetry, bars->selected, sizeof(int) * 2 * PUBLISHER_HISTORY_CAPACITY);
+    bars->selected = NULL;
+}
+
+
+// Pick the bars LTTB keeps of the mid price into bars->selected
+static int history_select_price(barHistory *bars, int threshold) {
+    for (int i = 0; i < bars->count; i++) {
+        bars->mid[i] = (bars->bid[i] + bars->ask[i]) / 2;
+    }
+    return lttb_reduce(bars->line, bars->mid, bars->count, threshold, bars->selected);
+}
+
+
+// Keep a bar's close -- when the history is full it is reduced to half its size so it never stops growing in span
+static void history_add(barHistory *bars, const barRecord *bar) {
+    if (bars->count == PUBLISHER_HISTORY_CAPACITY) {
+        int kept = history_select_price(bars, PUBLISHER_HISTORY_CAPACITY / 2);
+        double *columns[] = {bars->line, bars->bid, bars->ask, bars->value};
+        for (size_t c = 0; c < sizeof(columns) / sizeof(columns[0]); c++) {
+            for (int i = 0; i < kept; i++) {
+                columns[c][i] = columns[c][bars->selected[i]];
+            }
+        }
+        bars->count = kept;
+    }
+    bars->line[bars->count] = (double) bar->lastLine;
+    bars->bid[bars->count] = bar->bidClose;
+    bars->ask[bars->count] = bar->askClose;
+    bars->value[bars->count] = bar->value;
+    bars->count++;
+    bars->barsSinceSent++;
+}
+
+
+// Send the whole history reduced with LTTB -- the price series keeps the shape of the mid, the value series its own
+static void history_send(barHistory *bars) {
+    if (bars->count == 0 || bars->points < 3) {
+        return;
+    }
+    bars->generation++;
+    bars->barsSinceSent = 0;
+    bars->lastSentMs = get_time_ms();
+
+    // The value series is picked into the second half of selected so both counts are known before sending
+    int pricePoints = history_select_price(bars, bars->points);
+    int *valueSelected = bars->selected + pricePoints;
+    int valuePoints = lttb_reduce(bars->line, bars->value, bars->count, bars->points, valueSelected);
+    uint16_t total = (uint16_t) (pricePoints + valuePoints);
+
+    for (int i = 0; i < pricePoints; i++) {
+        int bar = bars->selected[i];
+        historyPoint point = {(int64_t) bars->line[bar], bars->bid[bar], bars->ask[bar], bars->generation, HistoryPrice, total};
+        telemetry_send_history(publisherSender, &point);
+    }
+    for (int i = 0; i < valuePoints; i++) {
+        int bar = valueSelected[i];
+        historyPoint point = {(int64_t) bars->line[bar], bars->value[bar], 0, bars->generation, HistoryValue, total};
+        telemetry_send_history(publisherSender, &point);
+    }
+}
+
+
+// Send a finished bar and fold it into the long history -- the history goes out on a wall-clock cadence rather than
+// every so many bars, so a faster replay makes more bars but not more histories
+static void publish_bar(const barRecord *bar) {
+    telemetry_send_bar(publisherSender, bar);
+    history_add(&history, bar);
+    if (get_time_ms() - history.lastSentMs >= PUBLISHER_HISTORY_INTERVAL_MS) {
+        history_send(&history);
+    }
+}
+
+
+// Downsample one tick -- only finished bars and histories are sent
+static void publish_tick(const tickRecord *record) {
+    barRecord bar;
+    if (bar_aggregator_add(&bars, record, &bar)) {
+        publish_bar(&bar);
+    }
+}
+
+
+// Send the levels that changed since the last snapshot sent
+static void publish_depth(const depthSnapshot *snapshot) {
+    depthRecord records[DEPTH_MAX_RECORDS];
+    int count = depth_encode(&depth, snapshot, records);
+    for (int i = 0; i < count; i++) {
+        telemetry_send_depth(publisherSender, &records[i]);
+    }
+}
+
+
+// Send the part-filled bar and a final history once the data has ended
+static void publish_end() {
+    barRecord bar;
+    if (bar_aggregator_flush(&bars, &bar)) {
+        publish_bar(&bar);
+    }
+    if (history.barsSinceSent > 0) {
+        history_send(&history);
+    }
+    telemetry_flush(publisherSender);
+}
+
+
+// Background thread -- downsamples queued ticks and sends the result, sleeping when there is nothing to do
+static void *publisher_loop(void *arg) {
+    (void) arg;
+    tickRecord record;
+    depthSnapshot snapshot;
+    int idlePolls = 0;
+    while (true) {
+        bool stopping = atomic_load(&publisherStop);
+        unsigned long long moved = 0;
+        while (queue_pop(&tickQueue, &record)) {
+            publish_tick(&record);
+            moved++;
+        }
+        while (depthEnabled && queue_pop(&depthQueue, &snapshot)) {
+            publish_depth(&snapshot);
+            moved++;
+        }
+        // The stop flag was seen before draining, so every tick pushed before publisher_stop is out
+        if (stopping) {
+            break;
+        }
+        if (moved > 0) {
+            idlePolls = 0;
+            continue;
+        }
+        // Quiet feed -- don't leave the grapher waiting on a packet that won't fill
+        if (++idlePolls == PUBLISHER_IDLE_FLUSH_POLLS) {
+            telemetry_flush(publisherSender);
+        }
+#ifdef _WIN32
+        Sleep(1);
+#else
+        usleep(1000);
+#endif
+    }
+    publish_end();
+    return NULL;
+}
+
+
+// Start publishing through a background thread -- ticks are gathered into bars of bucketTicks ticks (or bucketNs of
+// tick time if > 0), with a long history of historyPoints points per series. Depth snapshots are accepted if
+// depthSnapshotEvery > 0, and are sent as changed levels with a full snapshot that often. If the thread can't be
+// started the same is done inline instead
+bool publisher_start(telemetrySender *sender, int bucketTicks, long long bucketNs, int historyPoints, int depthSnapshotEvery) {
+    publisherSender = sender;
+    publisherRunning = false;
+    bar_aggregator_init(&bars, bucketTicks, bucketNs);
+    history_init(&history, historyPoints);
+    if (!queue_init(&tickQueue, sizeof(tickRecord), PUBLISHER_QUEUE_TICKS)) {
+        printf("Error Allocating Memory!\n");
+        exit(-1);
+    }
+    depthEnabled = depthSnapshotEvery > 0;
+    if (depthEnabled) {
+        depth_encoder_init(&depth, depthSnapshotEvery);
+        if (!queue_init(&depthQueue, sizeof(depthSnapshot), PUBLISHER_QUEUE_DEPTH)) {
+            printf("Error Allocating Memory!\n");
+            exit(-1);
+        }
+    }
+    atomic_store(&publisherStop, false);
+    if (pthread_create(&publisherThread, NULL, publisher_loop, NULL) != 0) {
+        printf("Failed to start telemetry publisher thread - publishing inline\n");
+        return false;
+    }
+    publisherRunning = true;
+    return true;
+}
+
+
+// Hand a tick to the publisher -- a bounded copy on the calling thread, never a wait or a system call
+void publisher_push_tick(const tickRecord *record) {
+    if (!publisherRunning) {
+        if (publisherSender != NULL) {
+            publish_tick(record);
+        }
+        return;
+    }
+    queue_push(&tickQueue, record);
+}
+
+
+// Hand a depth snapshot to the publisher -- ignored unless the depth stream was enabled
+void publisher_push_depth(const depthSnapshot *snapshot) {
+    if (!depthEnabled) {
+        return;
+    }
+    if (!publisherRunning) {
+        if (publisherSender != NULL) {
+            publish_depth(snapshot);
+        }
+        return;
+    }
+    queue_push(&depthQueue, snapshot);
+}
+
+
+// Wait for the publisher to send everything queued, then stop it -- the sender is left open for the caller to close
+void publisher_stop() {
+    if (publisherRunning) {
+        atomic_store(&publisherStop, true);
+        pthread_join(publisherThread, NULL);
+        publisherRunning = false;
+        if (tickQueue.dropped > 0) {
+            printf("Telemetry publisher fell behind - %llu ticks were overwritten before they were sent\n", tickQueue.dropped);
+        }
+        if (depthEnabled && depthQueue.dropped > 0) {
+            printf("Telemetry publisher fell behind - %llu depth snapshots were overwritten before they were sent\n", depthQueue.dropped);
+        }
+    } else if (publisherSender != NULL) {
+        publish_end();
+    }
+    if (tickQueue.slots != NULL) {
+        queue_free(&tickQueue);
+        history_free(&history);
+    }
+    if (depthQueue.slots != NULL) {
+        queue_free(&depthQueue);
+    }
+    depthEnabled = false;
+    publisherSender = NULL;
+}
+
+
+// Ticks overwritten before the publisher got to them
+unsigned long long publisher_dropped() {
+    return tickQueue.dropped;
+}
\ No newline at end of file
@@ -0,0 +1,31 @@
+#ifndef TELEMETRY_PUBLISHER_H
+#define TELEMETRY_PUBLISHER_H
+
+// Standard includes
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+// Including other project headers
+#include "telemetry.h"
+#include "downsample.h"
+#include "depth_stream.h"
+
+// Define the queue between the trading thread and the publisher -- a power of two, ~30ms of ticks at full speed
+#define PUBLISHER_QUEUE_TICKS 8192
+#define PUBLISHER_QUEUE_DEPTH 8192          // Depth snapshots queued -- also a power of two, ~2.8MB
+#define PUBLISHER_IDLE_FLUSH_POLLS 20       // Empty 1ms polls before a part-filled packet is sent anyway
+#define PUBLISHER_HISTORY_CAPACITY 65536    // Bars kept for the long history -- halved with LTTB when full
+#define PUBLISHER_HISTORY_INTERVAL_MS 1000  // Wall-clock time between long-history updates -- bars are the steady stream
+#define PUBLISHER_MAX_HISTORY_POINTS 30000  // Points per series in one history (both must fit a historyPoint total)
+
+// Function declarations
+bool publisher_start(telemetrySender *sender, int bucketTicks, long long bucketNs, int historyPoints, int depthSnapshotEvery);
+void publisher_push_tick(const tickRecord *record);
+void publisher_push_depth(const depthSnapshot *snapshot);
+void publisher_stop();
+unsigned long long publisher_dropped();
+
+#endif
\ No newline at end of file